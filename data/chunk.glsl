@@ -0,0 +1,59 @@
+// Chunk layout shared by the compute shaders. CHUNK_SIZE, WORK_GROUP_SIZE, SUB_CHUNK_SIZE, SUB_CHUNK_COUNT and
+// FACE_QUAD_COUNT_BITS are defined by the application from the constants in Chunk.hpp.
+
+struct GeometryData {
+    uint vertexCount;
+    uint indexCount;
+    uint vertexTail;
+    uint indexTail;
+    uint vertexCapacity;
+    uint indexCapacity;
+    uint overflow;
+    uint padding;
+};
+
+// Matches SubChunkFeedback in Chunk.hpp.
+struct ChunkFeedback {
+    uint vertexOffset;
+    uint vertexCount;
+    uint indexOffset;
+    uint indexCount;
+    uint vertexCapacity;
+    uint indexCapacity;
+    uint faceQuadCounts[2];
+};
+
+// Laid out as DrawElementsIndirectCommand, consumed by glMultiDrawElementsIndirectCount in MeshHeap::Draw.
+struct DrawCommandData {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+uint to1D(in uvec3 pos) {
+    return pos.x + CHUNK_SIZE * (pos.y + CHUNK_SIZE * pos.z);
+}
+
+int to1D(in ivec3 pos) {
+    return pos.x + CHUNK_SIZE * (pos.y + CHUNK_SIZE * pos.z);
+}
+
+uvec3 to3D(in uint idx) {
+    uint x = idx % CHUNK_SIZE;
+    uint y = (idx / CHUNK_SIZE) % CHUNK_SIZE;
+    uint z = idx / (CHUNK_SIZE * CHUNK_SIZE);
+    return uvec3(x, y, z);
+}
+
+uvec3 subChunkTo3D(in uint idx) {
+    uint x = idx % SUB_CHUNK_SIZE;
+    uint y = (idx / SUB_CHUNK_SIZE) % SUB_CHUNK_SIZE;
+    uint z = idx / (SUB_CHUNK_SIZE * SUB_CHUNK_SIZE);
+    return uvec3(x, y, z);
+}
+
+uint faceQuadCount(in ChunkFeedback feedback, in uint face) {
+    return (feedback.faceQuadCounts[face / 3] >> ((face % 3) * FACE_QUAD_COUNT_BITS)) & ((1u << FACE_QUAD_COUNT_BITS) - 1);
+}
@@ -1,18 +1,21 @@
 #version 460 core
-#extension GL_ARB_bindless_texture : enable
 
 layout (location = 0) in vec2 vUV;
 layout (location = 1) in vec3 vNormal;
+layout (location = 2) in float vOcclusion;
+layout (location = 3) in float vLight;
+layout (location = 4) flat in uint vLayer;
 
-layout (std430, binding = 4) buffer uSampler {
-    sampler2D uSamplers[];
-};
+// One tile per layer, see Texture. UVs are in voxel units and every layer repeats on its own, so merged greedy
+// quads tile without any wrapping here and mip levels never mix in neighbouring tiles.
+layout (binding = 0) uniform sampler2DArray uBlockTextures;
 
 layout (location = 0) out vec4 oColor;
 
 void main() {
     vec3 lightDir = normalize(vec3(-1.0));
     float nDotL = dot(-lightDir, vNormal);
-    oColor = vec4(texture(uSamplers[0], vUV).rgb, 1.0);
-    oColor = vec4(vNormal * 0.5 + 0.5, 1.0);
+
+    oColor = vec4(texture(uBlockTextures, vec3(vUV, float(vLayer))).rgb, 1.0);
+    oColor.rgb *= (0.75 + 0.25 * nDotL) * vOcclusion * vLight;
 }
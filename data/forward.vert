@@ -1,8 +1,8 @@
 #version 460 core
 
-layout (location = 0) in vec3 iPosition;
-layout (location = 1) in vec2 iUV;
-layout (location = 2) in vec3 iNormal;
+// Packed vertex, see Vertex in Chunk.hpp.
+layout (location = 0) in uint iPositionFace;
+layout (location = 1) in uint iMaterial;
 
 struct GlobalData {
     mat4 projection;
@@ -13,15 +13,70 @@ layout (std140, binding = 0) uniform GlobalUniform {
     GlobalData data;
 } uGlobal;
 
+// Matches DrawData in MeshHeap.hpp.
+struct DrawData {
+    vec3 origin;
+    uint ranges;
+    uint indexCapacity;
+    uint level;
+    uint padding0;
+    uint padding1;
+};
+
+// Indexed by the draw slot, which MeshHeap passes as the base instance of every indirect draw.
+layout (std430, binding = 10) readonly buffer DrawDataBuffer {
+    DrawData data[];
+} uDrawData;
+
 layout (location = 0) out vec2 vUV;
 layout (location = 1) out vec3 vNormal;
+layout (location = 2) out float vOcclusion;
+layout (location = 3) out float vLight;
+layout (location = 4) flat out uint vLayer;
+
+const vec3 cNormals[6] = vec3[](
+    vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0)
+);
+
+// Directions from corner 0 towards corner 3 (u) and corner 1 (v) of each face. Projecting the integer
+// position onto them gives UVs that advance by one per voxel, also across merged greedy quads.
+const vec3 cTangents[6] = vec3[](
+    vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0),
+    vec3(1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+    vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0)
+);
+
+const vec3 cBitangents[6] = vec3[](
+    vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0)
+);
+
+// Brightness per baked ambient occlusion value.
+const float cOcclusion[4] = float[](0.45, 0.65, 0.85, 1.0);
 
 out gl_PerVertex {
     vec4 gl_Position;
 };
 
 void main() {
-    vUV = iUV / 16.0 + vec2(1.0 / 16.0, 0.0) * 2;
-    vNormal = iNormal;
-    gl_Position = uGlobal.data.projection * uGlobal.data.view * vec4(iPosition, 1.0);
+    DrawData draw = uDrawData.data[gl_BaseInstance];
+
+    // Coarser levels are meshed on a grid of 1 << level voxels per cell.
+    vec3 position = vec3(uvec3(iPositionFace, iPositionFace >> 8, iPositionFace >> 16) & 0xFFu) * float(1u << draw.level);
+    uint face = (iPositionFace >> 24) & 0x7u;
+
+    vUV = vec2(dot(position, cTangents[face]), dot(position, cBitangents[face]));
+    vNormal = cNormals[face];
+    vOcclusion = cOcclusion[(iPositionFace >> 29) & 0x3u];
+    vLayer = iMaterial & 0xFFFFu;
+
+    // Every light level below full is 20% darker, the brighter of block and sky light wins.
+    uint light = max((iMaterial >> 16) & 0xFu, (iMaterial >> 20) & 0xFu);
+    vLight = pow(0.8, float(15u - light));
+
+    // Corners sit on the voxel grid, voxel centres are at integer coordinates.
+    gl_Position = uGlobal.data.projection * uGlobal.data.view * vec4(draw.origin + position - 0.5, 1.0);
 }
@@ -0,0 +1,18 @@
+// Voxels of the chunk being meshed, for the feedback and voxelizer passes.
+
+#include "chunk.glsl"
+
+layout (std430, binding = 1) readonly buffer VoxelBuffer {
+    int data[];
+} uVoxels;
+
+bool hasVoxel(in ivec3 coord) {
+    if (coord.x < 0 || coord.x >= CHUNK_SIZE ||
+        coord.y < 0 || coord.y >= CHUNK_SIZE ||
+        coord.z < 0 || coord.z >= CHUNK_SIZE) {
+        return false;
+    }
+
+    int idx = to1D(coord);
+    return uVoxels.data[idx] > 0;
+}
@@ -7,6 +7,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include <string>
+
+// Largest on-screen size, in pixels, of a voxel from a coarser chunk level.
+static constexpr float LevelOfDetailError = 8.0f;
+
 void OnWindowResize(GLFWwindow* window, int width, int height) {
 	((Application*)glfwGetWindowUserPointer(window))->OnWindowResize(width, height);
 }
@@ -52,10 +57,10 @@ void MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLs
 	printf("%s, %s, %s, %u: %s\n", srcStr, typeStr, severityStr, id, message);
 }
 
-Application::Application() {
+Application::Application(bool compareMeshes) {
 	glfwInit();
 
-	mWindow = glfwCreateWindow(1280, 720, "TheHolyGrail", nullptr, nullptr);
+	mWindow = glfwCreateWindow(mWidth, mHeight, "TheHolyGrail", nullptr, nullptr);
 
 	glfwSetWindowUserPointer(mWindow, this);
 
@@ -69,14 +74,69 @@ Application::Application() {
 	glDebugMessageCallback(&MessageCallback, nullptr);
 	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
 
-	mFeedbackShader = new Shader("data/feedback.comp");
-	mVoxelizerShader = new Shader("data/voxelizer.comp");
-	mForwardShader = new Shader("data/forward.vert", "data/forward.frag");
+	// Warm starts load the driver binaries from the cache and skip compiling GLSL altogether. Otherwise all
+	// sources are read in the background and handed to the driver before anything waits for a result; the
+	// first bind of each pipeline blocks until it is linked.
+	double shaderStartTime = glfwGetTime();
+
+	bool parallelCompilation = Shader::EnableParallelCompilation();
+
+	mShaderCache = new ShaderCache();
+
+	// The chunk kernels are specialized for the sizes compiled into the C++ side.
+	ShaderDefines chunkDefines = Chunk::GetShaderDefines();
+	chunkDefines.push_back({ "MAX_BLOCKS", std::to_string(BlockRegistry::MaxBlocks) });
+	chunkDefines.push_back({ "CULLING_WORK_GROUP_SIZE", std::to_string(MeshHeap::CullingWorkGroupSize) });
+
+	mFeedbackShader = new Shader("data/feedback.comp", mShaderCache, chunkDefines);
+	mVoxelizerShader = new Shader("data/voxelizer.comp", mShaderCache, chunkDefines);
+	mCullingShader = new Shader("data/culling.comp", mShaderCache, chunkDefines);
+	mDepthPyramidShader = new Shader("data/depthpyramid.comp", mShaderCache);
+	mForwardShader = new Shader("data/forward.vert", "data/forward.frag", mShaderCache);
+
+	mFeedbackShader->Compile();
+	mVoxelizerShader->Compile();
+	mCullingShader->Compile();
+	mDepthPyramidShader->Compile();
+	mForwardShader->Compile();
+
+	printf("Shaders: %.1f ms to submit%s, %u programs cached, %u compiled\n", (glfwGetTime() - shaderStartTime) * 1000.0,
+		parallelCompilation ? " (parallel)" : "", mShaderCache->GetHitCount(), mShaderCache->GetMissCount());
+
+	// One scheduler for all background and parallel work. Chunk generation and texture decoding only run on
+	// workers, so there is always at least one.
+	unsigned int workerCount = ThreadPool::DefaultThreadCount();
+	mThreadPool = new ThreadPool(workerCount > 0 ? workerCount : 1);
+
+	mTextureLoader = new TextureLoader(mThreadPool);
+
+	// The build bakes data/terrain.tex, which is mapped and uploaded right here. Without it the PNG is decoded
+	// in the background with the same options.
+	TextureFile blockTextureFile;
+	if (blockTextureFile.Open("data/terrain.tex")) {
+		mBlockTextures = new Texture(blockTextureFile);
+	}
+	else {
+		TextureOptions blockTextureOptions;
+		blockTextureOptions.TileWidth = 16;
+		blockTextureOptions.TileHeight = 16;
+		blockTextureOptions.Compression = TextureCompression::BC1;
+
+		mBlockTextures = mTextureLoader->Load("data/terrain.png", blockTextureOptions);
+	}
+
+	mWorld = new World(mThreadPool);
+	mDepthPyramid = new DepthPyramid();
+
+	if (compareMeshes) {
+		mCpuMesher = new CpuMesher(mThreadPool);
+	}
 
-	mChunk = new Chunk();
+	mGlobalData.View = Matrix4::Invert(Matrix4::CreateTranslation(mCameraPosition));
+	mGlobalData.Projection = Matrix4::CreatePerspective(Math::DegreesToRadians(45.0f), (float)mWidth / mHeight, 0.1f, 1000.0f);
+	mWorld->SetLevelOfDetail(0.5f * mHeight * mGlobalData.Projection.Values[5], LevelOfDetailError);
 
-	mGlobalData.View = Matrix4::Invert(Matrix4::CreateTranslation(Vector3(40.0f, 40.0f, 170.0f)));
-	mGlobalData.Projection = Matrix4::CreatePerspective(Math::DegreesToRadians(45.0f), 1280.0f / 720.0f, 0.1f, 1000.0f);
+	CreateFramebuffer();
 
 	glCreateBuffers(1, &mGlobalDataBufferId);
 	glNamedBufferStorage(mGlobalDataBufferId, sizeof(GlobalData), &mGlobalData, GL_DYNAMIC_STORAGE_BIT);
@@ -86,29 +146,33 @@ Application::Application() {
 	glEnable(GL_CULL_FACE);
 	glEnable(GL_DEPTH_TEST);
 
-	srand((unsigned int)time(NULL));
-
-	for (unsigned int x = 0; x < Chunk::ChunkSize; ++x) {
-		for (unsigned int y = 0; y < Chunk::ChunkSize; ++y) {
-			for (unsigned int z = 0; z < Chunk::ChunkSize; ++z) {
-				mChunk->SetVoxel(x, y, z, rand() % 2);
-			}
-		}
-	}
-
 	mLastTime = glfwGetTime();
+	mLastTitleTime = mLastTime;
+	mLastComparisonTime = mLastTime;
 
 	glfwSwapInterval(0);
 }
 
 Application::~Application() {
 	glDeleteBuffers(1, &mGlobalDataBufferId);
+	glDeleteFramebuffers(1, &mFramebufferId);
+	glDeleteTextures(1, &mDepthTextureId);
+	glDeleteTextures(1, &mColorTextureId);
+
+	delete mCpuMesher;
 
-	delete mChunk;
+	delete mDepthPyramid;
+	delete mWorld;
+	delete mTextureLoader;
+	delete mBlockTextures;
+	delete mThreadPool;
 
 	delete mForwardShader;
+	delete mDepthPyramidShader;
+	delete mCullingShader;
 	delete mVoxelizerShader;
 	delete mFeedbackShader;
+	delete mShaderCache;
 
 	glfwTerminate();
 }
@@ -118,23 +182,34 @@ void Application::Run() {
 		glfwPollEvents();
 
 		double currentTime = glfwGetTime();
-		if (currentTime > mLastTime + 0.05) {
-			for (unsigned int x = 0; x < Chunk::ChunkSize; ++x) {
-				for (unsigned int y = 0; y < Chunk::ChunkSize; ++y) {
-					for (unsigned int z = 0; z < Chunk::ChunkSize; ++z) {
-						mChunk->SetVoxel(x, y, z, rand() % 2);
-					}
-				}
-			}
-
-			mLastTime = currentTime;
-		}
+		UpdateCamera((float)(currentTime - mLastTime));
+		mLastTime = currentTime;
+
+		mTextureLoader->Update();
+
+		mWorld->Update(mCameraPosition);
+
+		UpdateBrush();
+
+		UpdateTitle();
 
 		glNamedBufferSubData(mGlobalDataBufferId, 0, sizeof(GlobalData), &mGlobalData);
 
+		// The scene goes to an offscreen target so that its depth can be reduced for the next frame's occlusion culling.
+		glBindFramebuffer(GL_FRAMEBUFFER, mFramebufferId);
+
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		mChunk->Render(mFeedbackShader, mVoxelizerShader, mForwardShader);
+		// Nothing is bound, and the blocks are black, until the loader has uploaded the texture.
+		glBindTextureUnit(0, mBlockTextures->GetId());
+
+		mWorld->Render(mFeedbackShader, mVoxelizerShader, mCullingShader, mForwardShader, mDepthPyramid);
+
+		CompareMeshes();
+
+		glBlitNamedFramebuffer(mFramebufferId, 0, 0, 0, mWidth, mHeight, 0, 0, mWidth, mHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+		mDepthPyramid->Build(mDepthPyramidShader, mDepthTextureId, mWidth, mHeight, mGlobalData.Projection, mGlobalData.View);
 
 		glfwSwapBuffers(mWindow);
 	}
@@ -143,7 +218,156 @@ void Application::Run() {
 void Application::OnWindowResize(int width, int height) {
 	glViewport(0, 0, width, height);
 
+	mWidth = width;
+	mHeight = height;
+
+	CreateFramebuffer();
+	mDepthPyramid->Invalidate();
+
 	mGlobalData.Projection = Matrix4::CreatePerspective(Math::DegreesToRadians(45.0f), (float)width / height, 0.1f, 1000.0f);
+	mWorld->SetLevelOfDetail(0.5f * height * mGlobalData.Projection.Values[5], LevelOfDetailError);
+}
+
+void Application::CreateFramebuffer() {
+	glDeleteFramebuffers(1, &mFramebufferId);
+	glDeleteTextures(1, &mDepthTextureId);
+	glDeleteTextures(1, &mColorTextureId);
+
+	mFramebufferId = 0;
+	mDepthTextureId = 0;
+	mColorTextureId = 0;
+
+	// Minimized windows report a zero size.
+	if (mWidth <= 0 || mHeight <= 0) {
+		return;
+	}
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &mColorTextureId);
+	glTextureStorage2D(mColorTextureId, 1, GL_RGBA8, mWidth, mHeight);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &mDepthTextureId);
+	glTextureParameteri(mDepthTextureId, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(mDepthTextureId, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureStorage2D(mDepthTextureId, 1, GL_DEPTH_COMPONENT32F, mWidth, mHeight);
+
+	glCreateFramebuffers(1, &mFramebufferId);
+	glNamedFramebufferTexture(mFramebufferId, GL_COLOR_ATTACHMENT0, mColorTextureId, 0);
+	glNamedFramebufferTexture(mFramebufferId, GL_DEPTH_ATTACHMENT, mDepthTextureId, 0);
+}
+
+void Application::UpdateCamera(float deltaTime) {
+	const float speed = 60.0f * deltaTime;
+
+	Vector3 direction = Vector3::Zero;
+	if (glfwGetKey(mWindow, GLFW_KEY_W) == GLFW_PRESS) {
+		direction.Z -= 1.0f;
+	}
+
+	if (glfwGetKey(mWindow, GLFW_KEY_S) == GLFW_PRESS) {
+		direction.Z += 1.0f;
+	}
+
+	if (glfwGetKey(mWindow, GLFW_KEY_A) == GLFW_PRESS) {
+		direction.X -= 1.0f;
+	}
+
+	if (glfwGetKey(mWindow, GLFW_KEY_D) == GLFW_PRESS) {
+		direction.X += 1.0f;
+	}
+
+	if (glfwGetKey(mWindow, GLFW_KEY_SPACE) == GLFW_PRESS) {
+		direction.Y += 1.0f;
+	}
+
+	if (glfwGetKey(mWindow, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
+		direction.Y -= 1.0f;
+	}
+
+	mCameraPosition += direction * speed;
+
+	if (glfwGetKey(mWindow, GLFW_KEY_1) == GLFW_PRESS) {
+		mWorld->SetMeshingMode(MeshingMode::Culled);
+	}
+
+	if (glfwGetKey(mWindow, GLFW_KEY_2) == GLFW_PRESS) {
+		mWorld->SetMeshingMode(MeshingMode::Greedy);
+	}
+
+	if (glfwGetKey(mWindow, GLFW_KEY_3) == GLFW_PRESS) {
+		mWorld->SetMeshingMode(MeshingMode::Binary);
+	}
+
+	mGlobalData.View = Matrix4::Invert(Matrix4::CreateTranslation(mCameraPosition));
+}
+
+void Application::UpdateBrush() {
+	bool carve = glfwGetMouseButton(mWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+	bool place = glfwGetMouseButton(mWindow, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+	bool lamp = glfwGetMouseButton(mWindow, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS;
+	if (!carve && !place && !lamp) {
+		return;
+	}
+
+	// Value 3 emits light, see World.
+	const unsigned int value = lamp ? 3 : (place ? 1 : 0);
+
+	const int radius = 4;
+	const Vector3 center = mCameraPosition + Vector3(0.0f, -20.0f, -60.0f);
+
+	int cx = (int)floorf(center.X + 0.5f);
+	int cy = (int)floorf(center.Y + 0.5f);
+	int cz = (int)floorf(center.Z + 0.5f);
+
+	mWorld->UpdateRegion(cx - radius, cy - radius, cz - radius, cx + radius + 1, cy + radius + 1, cz + radius + 1,
+		[=](int x, int y, int z, unsigned int current) {
+			int dx = x - cx;
+			int dy = y - cy;
+			int dz = z - cz;
+			return dx * dx + dy * dy + dz * dz <= radius * radius ? value : current;
+		});
+}
+
+void Application::UpdateTitle() {
+	if (mLastTime < mLastTitleTime + 1.0) {
+		return;
+	}
+
+	const WorldStatistics& statistics = mWorld->GetStatistics();
+	const MeshHeapStatistics heapStatistics = mWorld->GetMeshHeap().GetStatistics();
+	const CullingStatistics& cullingStatistics = mWorld->GetMeshHeap().GetCullingStatistics();
+	const LightStatistics& lightStatistics = mWorld->GetLightStatistics();
+	const char* meshingModes[] = { "culled", "greedy", "binary" };
+
+	char title[640];
+	snprintf(title, sizeof(title), "TheHolyGrail - %s meshing, chunks %u (pending %u), loads %u, unloads %u, streaming %.3f ms, "
+		"mesh heap %.1f / %.1f MB in %u pages (fragmentation %.0f%%), triangles %u drawn, %u frustum culled, %u occlusion culled, "
+		"%u direction culled, %u vertices submitted, light %.3f ms (%u voxels, %u rounds, %u chunks)",
+		meshingModes[(int)mWorld->GetMeshingMode()],
+		statistics.LoadedChunks, statistics.PendingChunks, statistics.TotalLoads, statistics.TotalUnloads, statistics.FrameTime * 1000.0,
+		heapStatistics.UsedBytes / (1024.0 * 1024.0), heapStatistics.ReservedBytes / (1024.0 * 1024.0), heapStatistics.Pages,
+		heapStatistics.Fragmentation * 100.0f,
+		cullingStatistics.DrawnTriangles, cullingStatistics.FrustumCulledTriangles, cullingStatistics.OcclusionCulledTriangles,
+		cullingStatistics.DirectionCulledTriangles, cullingStatistics.SubmittedVertices,
+		lightStatistics.Time * 1000.0, lightStatistics.VisitedVoxels, lightStatistics.Rounds, lightStatistics.Chunks);
+
+	glfwSetWindowTitle(mWindow, title);
+
+	mLastTitleTime = mLastTime;
+}
+
+void Application::CompareMeshes() {
+	if (!mCpuMesher || mLastTime < mLastComparisonTime + 1.0) {
+		return;
+	}
+
+	double startTime = glfwGetTime();
+	MeshComparison comparison = mWorld->CompareMeshes(*mCpuMesher);
+	double elapsedTime = glfwGetTime() - startTime;
+
+	printf("Mesh comparison: %u chunks, %u mismatches, GPU %u triangles, CPU %u triangles (%.1f ms)\n",
+		comparison.Chunks, comparison.Mismatches, comparison.GpuTriangles, comparison.CpuTriangles, elapsedTime * 1000.0);
+
+	mLastComparisonTime = mLastTime;
 }
 
 void Application::CreatePerspectiveMatrix(float fovy, float aspect, float zNear, float zFar, float* output) {
@@ -1,9 +1,15 @@
 #pragma once 
 
+#include "CpuMesher.hpp"
+#include "DepthPyramid.hpp"
 #include "Shader.hpp"
 #include "Texture.hpp"
-#include "Chunk.hpp"
+#include "TextureFile.hpp"
+#include "TextureLoader.hpp"
+#include "World.hpp"
 #include "Matrix4.hpp"
+#include "ThreadPool.hpp"
+#include "Vector3.hpp"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -15,7 +21,7 @@ struct GlobalData {
 
 class Application {
 public:
-    Application();
+    Application(bool compareMeshes = false);
 
     ~Application();
 
@@ -24,15 +30,41 @@ public:
     void OnWindowResize(int width, int height);
 
 private:
+    void UpdateCamera(float deltaTime);
+
+    void UpdateBrush();
+
+    void UpdateTitle();
+
+    void CompareMeshes();
+
+    void CreateFramebuffer();
+
     void CreatePerspectiveMatrix(float fovy, float aspect, float zNear, float zFar, float* output);
 
 private:
     GLFWwindow* mWindow = nullptr;
     Shader* mFeedbackShader = nullptr;
     Shader* mVoxelizerShader = nullptr;
+    Shader* mCullingShader = nullptr;
+    Shader* mDepthPyramidShader = nullptr;
     Shader* mForwardShader = nullptr;
-    Chunk* mChunk = nullptr;
+    ShaderCache* mShaderCache = nullptr;
+    TextureLoader* mTextureLoader = nullptr;
+    Texture* mBlockTextures = nullptr;
+    World* mWorld = nullptr;
+    DepthPyramid* mDepthPyramid = nullptr;
+    ThreadPool* mThreadPool = nullptr;
+    CpuMesher* mCpuMesher = nullptr;
+    Vector3 mCameraPosition = Vector3(40.0f, 60.0f, 170.0f);
     GlobalData mGlobalData;
     GLuint mGlobalDataBufferId = 0;
+    GLuint mFramebufferId = 0;
+    GLuint mColorTextureId = 0;
+    GLuint mDepthTextureId = 0;
+    int mWidth = 1280;
+    int mHeight = 720;
     double mLastTime = 0.0;
+    double mLastTitleTime = 0.0;
+    double mLastComparisonTime = 0.0;
 };
@@ -0,0 +1,779 @@
+#include "Benchmark.hpp"
+#include "Chunk.hpp"
+#include "ChunkLayout.hpp"
+#include "CpuMesher.hpp"
+#include "LightEngine.hpp"
+#include "Math.hpp"
+#include "Texture.hpp"
+#include "TextureFile.hpp"
+#include "ThreadPool.hpp"
+#include "VoxelStorage.hpp"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <vector>
+
+void Benchmark::Run() {
+    RunVoxelStorage();
+    RunBulkWrites();
+    RunMeshing();
+    RunGreedyMeshing();
+    RunBinaryMeshing();
+    RunLevelOfDetail();
+    RunAmbientOcclusion();
+    RunLightPropagation();
+    RunTextureDecoding();
+    RunChunkDimensions();
+    RunJobSystem();
+}
+
+void Benchmark::RunVoxelStorage() {
+    const unsigned int typeCounts[] = { 2, 16, 64, 1024 };
+
+    std::vector<unsigned int> values(Chunk::VoxelCount);
+    std::vector<unsigned int> indices(Chunk::VoxelCount);
+
+    printf("VoxelStorage (%u voxels)\n", Chunk::VoxelCount);
+
+    for (unsigned int typeCount : typeCounts) {
+        for (unsigned int i = 0; i < Chunk::VoxelCount; ++i) {
+            values[i] = rand() % typeCount;
+            indices[i] = rand() % Chunk::VoxelCount;
+        }
+
+        std::vector<unsigned int> flat(Chunk::VoxelCount, 0);
+        VoxelStorage storage(Chunk::VoxelCount);
+
+        double start = GetTime();
+        for (unsigned int i = 0; i < Chunk::VoxelCount; ++i) {
+            if (flat[i] != values[i]) {
+                flat[i] = values[i];
+            }
+        }
+        double flatWrite = GetTime() - start;
+
+        start = GetTime();
+        for (unsigned int i = 0; i < Chunk::VoxelCount; ++i) {
+            storage.SetVoxel(i, values[i]);
+        }
+        double paletteWrite = GetTime() - start;
+
+        unsigned int flatSum = 0;
+        start = GetTime();
+        for (unsigned int i = 0; i < Chunk::VoxelCount; ++i) {
+            flatSum += flat[indices[i]];
+        }
+        double flatRead = GetTime() - start;
+
+        unsigned int paletteSum = 0;
+        start = GetTime();
+        for (unsigned int i = 0; i < Chunk::VoxelCount; ++i) {
+            paletteSum += storage.GetVoxel(indices[i]);
+        }
+        double paletteRead = GetTime() - start;
+
+        if (flatSum != paletteSum) {
+            printf("  types %4u: checksum mismatch (%u != %u)\n", typeCount, flatSum, paletteSum);
+        }
+
+        double flatMemory = (double)(flat.size() * sizeof(unsigned int));
+        double paletteMemory = (double)storage.GetMemoryUsage();
+
+        printf("  types %4u: flat write %7.1f MVox/s read %7.1f MVox/s %7.1f KB | palette (%2u bit) write %7.1f MVox/s read %7.1f MVox/s %7.1f KB (%.1fx smaller)\n",
+            typeCount,
+            Chunk::VoxelCount / flatWrite * 1e-6, Chunk::VoxelCount / flatRead * 1e-6, flatMemory / 1024.0,
+            storage.GetBitsPerIndex(),
+            Chunk::VoxelCount / paletteWrite * 1e-6, Chunk::VoxelCount / paletteRead * 1e-6, paletteMemory / 1024.0,
+            flatMemory / paletteMemory);
+    }
+}
+
+void Benchmark::RunBulkWrites() {
+    const unsigned int size = Chunk::ChunkSize;
+    const int radius = 16;
+    const int center = (int)size / 2;
+
+    std::vector<unsigned int> values(Chunk::VoxelCount);
+    for (unsigned int i = 0; i < Chunk::VoxelCount; ++i) {
+        values[i] = rand() % 2;
+    }
+
+    // Paints a sphere of material; strokes alternate between two materials so that every one changes voxels.
+    auto brush = [=](unsigned int material) {
+        return [=](unsigned int x, unsigned int y, unsigned int z, unsigned int value) {
+            int dx = (int)x - center;
+            int dy = (int)y - center;
+            int dz = (int)z - center;
+            return dx * dx + dy * dy + dz * dz <= radius * radius ? material : value;
+        };
+    };
+
+    printf("Bulk writes (%u voxels per chunk)\n", Chunk::VoxelCount);
+
+    {
+        Chunk perVoxel;
+        double start = GetTime();
+        for (unsigned int z = 0; z < size; ++z) {
+            for (unsigned int y = 0; y < size; ++y) {
+                for (unsigned int x = 0; x < size; ++x) {
+                    perVoxel.SetVoxel(x, y, z, values[x + size * (y + size * z)]);
+                }
+            }
+        }
+        double perVoxelTime = GetTime() - start;
+
+        Chunk bulk;
+        start = GetTime();
+        bulk.SetVoxels(0, 0, 0, size, size, size, values.data());
+        double bulkTime = GetTime() - start;
+
+        printf("  generate (random):  SetVoxel %7.1f MVox/s | SetVoxels  %7.1f MVox/s (%.1fx)\n",
+            Chunk::VoxelCount / perVoxelTime * 1e-6, Chunk::VoxelCount / bulkTime * 1e-6, perVoxelTime / bulkTime);
+    }
+
+    {
+        Chunk perVoxel;
+        double start = GetTime();
+        for (unsigned int z = 0; z < size; ++z) {
+            for (unsigned int y = 0; y < size / 2; ++y) {
+                for (unsigned int x = 0; x < size; ++x) {
+                    perVoxel.SetVoxel(x, y, z, 1);
+                }
+            }
+        }
+        double perVoxelTime = GetTime() - start;
+
+        Chunk bulk;
+        start = GetTime();
+        bulk.FillRegion(0, 0, 0, size, size / 2, size, 1);
+        double bulkTime = GetTime() - start;
+
+        printf("  generate (fill):    SetVoxel %7.1f MVox/s | FillRegion %7.1f MVox/s (%.1fx)\n",
+            Chunk::VoxelCount / 2 / perVoxelTime * 1e-6, Chunk::VoxelCount / 2 / bulkTime * 1e-6, perVoxelTime / bulkTime);
+    }
+
+    {
+        Chunk perVoxel;
+        Chunk bulk;
+        perVoxel.SetVoxels(0, 0, 0, size, size, size, values.data());
+        bulk.SetVoxels(0, 0, 0, size, size, size, values.data());
+
+        // The brush materials are already in the chunk, as after the first strokes; growing the palette for them
+        // costs the same on both paths and would hide the difference.
+        perVoxel.SetVoxel(0, 0, 0, 3);
+        perVoxel.SetVoxel(1, 0, 0, 4);
+        bulk.SetVoxel(0, 0, 0, 3);
+        bulk.SetVoxel(1, 0, 0, 4);
+
+        const unsigned int strokes = 20;
+        const unsigned int min = center - radius;
+        const unsigned int max = center + radius + 1;
+        const unsigned int count = (max - min) * (max - min) * (max - min) * strokes;
+
+        double start = GetTime();
+        for (unsigned int stroke = 0; stroke < strokes; ++stroke) {
+            auto paint = brush(3 + stroke % 2);
+            for (unsigned int z = min; z < max; ++z) {
+                for (unsigned int y = min; y < max; ++y) {
+                    for (unsigned int x = min; x < max; ++x) {
+                        perVoxel.SetVoxel(x, y, z, paint(x, y, z, perVoxel.GetVoxel(x, y, z)));
+                    }
+                }
+            }
+        }
+        double perVoxelTime = GetTime() - start;
+
+        start = GetTime();
+        for (unsigned int stroke = 0; stroke < strokes; ++stroke) {
+            bulk.UpdateRegion(min, min, min, max, max, max, brush(3 + stroke % 2));
+        }
+        double bulkTime = GetTime() - start;
+
+        printf("  brush (r=%d, %u strokes): SetVoxel %7.1f MVox/s | UpdateRegion %5.1f MVox/s (%.1fx)\n",
+            radius, strokes, count / perVoxelTime * 1e-6, count / bulkTime * 1e-6, perVoxelTime / bulkTime);
+    }
+}
+
+void Benchmark::RunMeshing() {
+    const unsigned int iterations = 10;
+
+    Chunk terrain;
+    GenerateTerrain(terrain);
+
+    Chunk noise;
+    std::vector<unsigned int> values(Chunk::VoxelCount);
+    for (unsigned int i = 0; i < Chunk::VoxelCount; ++i) {
+        values[i] = rand() % 2;
+    }
+    noise.SetVoxels(0, 0, 0, Chunk::ChunkSize, Chunk::ChunkSize, Chunk::ChunkSize, values.data());
+
+    ThreadPool singleThread(0);
+    ThreadPool threadPool;
+
+    const Chunk* chunks[] = { &terrain, &noise };
+    const char* chunkNames[] = { "terrain", "noise" };
+    ThreadPool* threadPools[] = { &singleThread, &threadPool };
+
+    printf("CpuMesher (%u voxels per chunk, %u iterations)\n", Chunk::VoxelCount, iterations);
+
+    for (unsigned int i = 0; i < 2; ++i) {
+        for (ThreadPool* pool : threadPools) {
+            CpuMesher mesher(pool);
+            CpuMesh mesh;
+
+            double start = GetTime();
+            for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+                mesher.Mesh(*chunks[i], mesh);
+            }
+            double time = (GetTime() - start) / iterations;
+
+            unsigned int triangles = (unsigned int)mesh.Indices.size() / 3;
+
+            printf("  %-8s %2u threads: %7.2f ms, %8u triangles, %7.1f MVox/s, %7.1f MTri/s\n",
+                chunkNames[i], pool->GetThreadCount(), time * 1000.0, triangles,
+                Chunk::VoxelCount / time * 1e-6, triangles / time * 1e-6);
+        }
+    }
+}
+
+void Benchmark::RunGreedyMeshing() {
+    const unsigned int iterations = 10;
+
+    Chunk terrain;
+    GenerateTerrain(terrain);
+
+    ThreadPool threadPool;
+    CpuMesher mesher(&threadPool);
+
+    const MeshingMode modes[] = { MeshingMode::Culled, MeshingMode::Greedy };
+    const char* modeNames[] = { "culled", "greedy" };
+
+    unsigned int triangles[2] = {};
+    size_t bytes[2] = {};
+
+    printf("Greedy meshing (terrain, %u threads, %u iterations)\n", threadPool.GetThreadCount(), iterations);
+
+    for (unsigned int i = 0; i < 2; ++i) {
+        CpuMesh mesh;
+
+        double start = GetTime();
+        for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+            mesher.Mesh(terrain, mesh, modes[i]);
+        }
+        double time = (GetTime() - start) / iterations;
+
+        triangles[i] = (unsigned int)mesh.Indices.size() / 3;
+        bytes[i] = mesh.Vertices.size() * sizeof(Vertex) + mesh.Indices.size() * sizeof(unsigned int);
+
+        printf("  %s: %7.2f ms, %8u triangles, %8u vertices, %8.1f KB\n",
+            modeNames[i], time * 1000.0, triangles[i], (unsigned int)mesh.Vertices.size(), bytes[i] / 1024.0);
+    }
+
+    printf("  greedy / culled: %.1fx fewer triangles, %.1fx less memory\n",
+        (double)triangles[0] / Math::Max((int)triangles[1], 1), (double)bytes[0] / Math::Max((int)bytes[1], 1));
+}
+
+void Benchmark::RunBinaryMeshing() {
+    const unsigned int iterations = 20;
+
+    Chunk terrain;
+    GenerateTerrain(terrain);
+
+    Chunk noise;
+    std::vector<unsigned int> values(Chunk::VoxelCount);
+    for (unsigned int i = 0; i < Chunk::VoxelCount; ++i) {
+        values[i] = rand() % 2;
+    }
+    noise.SetVoxels(0, 0, 0, Chunk::ChunkSize, Chunk::ChunkSize, Chunk::ChunkSize, values.data());
+
+    const Chunk* chunks[] = { &terrain, &noise };
+    const char* chunkNames[] = { "terrain", "noise" };
+
+    CpuMesher mesher;
+
+    printf("Binary meshing (1 thread, %u iterations)\n", iterations);
+
+    for (unsigned int i = 0; i < 2; ++i) {
+        CpuMesh culled;
+        CpuMesh binary;
+
+        double start = GetTime();
+        for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+            mesher.Mesh(*chunks[i], culled, MeshingMode::Culled);
+        }
+        double culledTime = (GetTime() - start) / iterations;
+
+        start = GetTime();
+        for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+            mesher.Mesh(*chunks[i], binary, MeshingMode::Binary);
+        }
+        double binaryTime = (GetTime() - start) / iterations;
+
+        printf("  %-8s culled %7.2f ms | binary %7.2f ms (%.1fx), %u triangles%s\n",
+            chunkNames[i], culledTime * 1000.0, binaryTime * 1000.0, culledTime / binaryTime,
+            (unsigned int)binary.Indices.size() / 3, culled.Indices.size() == binary.Indices.size() ? "" : " (MISMATCH)");
+    }
+}
+
+void Benchmark::RunLevelOfDetail() {
+    const unsigned int iterations = 20;
+
+    Chunk terrain;
+    GenerateTerrain(terrain);
+
+    ThreadPool threadPool;
+    CpuMesher mesher(&threadPool);
+
+    printf("Level of detail (terrain, culled, %u threads, %u iterations)\n", threadPool.GetThreadCount(), iterations);
+
+    for (unsigned int level = 0; level < Chunk::LevelCount; ++level) {
+        terrain.SetLevel(level);
+
+        CpuMesh mesh;
+
+        double start = GetTime();
+        for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+            mesher.Mesh(terrain, mesh, MeshingMode::Culled);
+        }
+        double time = (GetTime() - start) / iterations;
+
+        printf("  level %u (%2ux): %7.2f ms, %8u triangles\n",
+            level, 1u << level, time * 1000.0, (unsigned int)mesh.Indices.size() / 3);
+    }
+}
+
+void Benchmark::RunAmbientOcclusion() {
+    const unsigned int iterations = 20;
+
+    Chunk terrain;
+    GenerateTerrain(terrain);
+
+    CpuMesher mesher;
+
+    const MeshingMode modes[] = { MeshingMode::Culled, MeshingMode::Greedy, MeshingMode::Binary };
+    const char* modeNames[] = { "culled", "greedy", "binary" };
+
+    printf("Ambient occlusion (terrain, 1 thread, %u iterations)\n", iterations);
+
+    for (unsigned int i = 0; i < 3; ++i) {
+        double times[2];
+        unsigned int triangles[2];
+
+        for (unsigned int occlusion = 0; occlusion < 2; ++occlusion) {
+            mesher.SetAmbientOcclusion(occlusion != 0);
+
+            CpuMesh mesh;
+
+            double start = GetTime();
+            for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+                mesher.Mesh(terrain, mesh, modes[i]);
+            }
+            times[occlusion] = (GetTime() - start) / iterations;
+            triangles[occlusion] = (unsigned int)mesh.Indices.size() / 3;
+        }
+
+        printf("  %-6s without %7.2f ms | with %7.2f ms (+%.2f ms), %u -> %u triangles\n",
+            modeNames[i], times[0] * 1000.0, times[1] * 1000.0, (times[1] - times[0]) * 1000.0, triangles[0], triangles[1]);
+    }
+}
+
+void Benchmark::RunLightPropagation() {
+    const unsigned int gridSize = 3;
+    const unsigned int size = Chunk::ChunkSize;
+    const unsigned int lamp = 3;
+    const double frameBudget = 1.0 / 60.0;
+
+    ThreadPool threadPool;
+    LightEngine engine(&threadPool);
+    engine.SetEmission(lamp, LightEngine::MaxLevel);
+
+    // A 3x3 grid of terrain chunks with open air above the middle one.
+    std::vector<Chunk*> chunks;
+    std::vector<ChunkCoordinate> coordinates;
+
+    for (int z = 0; z < (int)gridSize; ++z) {
+        for (int x = 0; x < (int)gridSize; ++x) {
+            Chunk* chunk = new Chunk();
+            GenerateTerrain(*chunk);
+            chunks.push_back(chunk);
+            coordinates.push_back({ x, 0, z });
+        }
+    }
+
+    chunks.push_back(new Chunk());
+    coordinates.push_back({ 1, 1, 1 });
+
+    printf("Light propagation (%u chunks, %u threads, frame budget %.1f ms)\n",
+        (unsigned int)chunks.size(), threadPool.GetThreadCount(), frameBudget * 1000.0);
+
+    double start = GetTime();
+    for (Chunk* chunk : chunks) {
+        engine.LightChunk(*chunk);
+    }
+    printf("  initial lighting:  %7.2f ms per chunk\n", (GetTime() - start) / chunks.size() * 1000.0);
+
+    start = GetTime();
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        engine.AddChunk(coordinates[i], chunks[i]);
+    }
+    engine.Update();
+
+    const LightStatistics& statistics = engine.GetStatistics();
+    printf("  link and exchange: %7.2f ms, %8u voxels, %2u rounds, %u chunks changed\n",
+        (GetTime() - start) * 1000.0, statistics.VisitedVoxels, statistics.Rounds, statistics.Chunks);
+
+    // Edits around the corner shared by the four chunks in the +X +Z quadrant, world coordinates.
+    struct Edit {
+        const char* Name;
+        int Min[3];
+        int Max[3];
+        unsigned int Value;
+    };
+
+    const int corner = (int)size * 2;
+    const Edit edits[] = {
+        { "carve cave", { corner - 20, 4, corner - 20 }, { corner + 20, 20, corner + 20 }, 0 },
+        { "place lamp", { corner - 1, 10, corner - 1 }, { corner + 1, 12, corner + 1 }, lamp },
+        { "open roof", { corner - 8, 20, corner - 8 }, { corner + 8, (int)size, corner + 8 }, 0 },
+        { "close roof", { corner - 8, 20, corner - 8 }, { corner + 8, 40, corner + 8 }, 1 },
+        { "remove lamp", { corner - 1, 10, corner - 1 }, { corner + 1, 12, corner + 1 }, 0 },
+    };
+
+    for (const Edit& edit : edits) {
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            const int origin[3] = { coordinates[i].X * (int)size, coordinates[i].Y * (int)size, coordinates[i].Z * (int)size };
+
+            unsigned int localMin[3];
+            unsigned int localMax[3];
+            for (unsigned int axis = 0; axis < 3; ++axis) {
+                localMin[axis] = (unsigned int)Math::Max(edit.Min[axis] - origin[axis], 0);
+                localMax[axis] = (unsigned int)Math::Min(edit.Max[axis] - origin[axis], (int)size);
+            }
+
+            if (localMin[0] >= localMax[0] || localMin[1] >= localMax[1] || localMin[2] >= localMax[2]) {
+                continue;
+            }
+
+            chunks[i]->FillRegion(localMin[0], localMin[1], localMin[2], localMax[0], localMax[1], localMax[2], edit.Value);
+            engine.Invalidate(coordinates[i], localMin[0], localMin[1], localMin[2], localMax[0], localMax[1], localMax[2]);
+        }
+
+        start = GetTime();
+        engine.Update();
+        double time = GetTime() - start;
+
+        printf("  %-12s       %7.2f ms, %8u voxels, %2u rounds, %u chunks changed, %s\n",
+            edit.Name, time * 1000.0, statistics.VisitedVoxels, statistics.Rounds, statistics.Chunks,
+            time <= frameBudget ? "within budget" : "over budget");
+    }
+
+    for (Chunk* chunk : chunks) {
+        delete chunk;
+    }
+}
+
+void Benchmark::RunTextureDecoding() {
+    const unsigned int iterations = 5;
+    const char* filename = "data/terrain.png";
+
+    struct Variant {
+        const char* Name;
+        bool Mipmaps;
+        TextureCompression Compression;
+    };
+
+    const Variant variants[] = {
+        { "rgba8, 1 level", false, TextureCompression::None },
+        { "rgba8, mips", true, TextureCompression::None },
+        { "bc1, mips", true, TextureCompression::BC1 },
+        { "bc3, mips", true, TextureCompression::BC3 },
+    };
+
+    printf("Texture decoding (%s as 16x16 layers, %u iterations)\n", filename, iterations);
+
+    size_t referenceSize = 0;
+    double bakedDecodeTime = 0.0;
+    TextureImage baked;
+
+    for (const Variant& variant : variants) {
+        TextureOptions options;
+        options.TileWidth = 16;
+        options.TileHeight = 16;
+        options.Mipmaps = variant.Mipmaps;
+        options.Compression = variant.Compression;
+
+        TextureImage image;
+
+        double start = GetTime();
+        for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+            if (!image.Decode(filename, options)) {
+                printf("  %s not found\n", filename);
+                return;
+            }
+        }
+        double time = (GetTime() - start) / iterations;
+
+        if (variant.Mipmaps && variant.Compression == TextureCompression::None) {
+            referenceSize = image.Data.size();
+        }
+
+        // What the build bakes for the game.
+        if (variant.Compression == TextureCompression::BC1) {
+            bakedDecodeTime = time;
+            baked = image;
+        }
+
+        printf("  %-15s %7.2f ms, %2u levels, %7.1f KB",
+            variant.Name, time * 1000.0, (unsigned int)image.Levels.size(), image.Data.size() / 1024.0);
+
+        if (referenceSize && variant.Compression != TextureCompression::None) {
+            printf(" (%.1fx smaller)", (double)referenceSize / image.Data.size());
+        }
+
+        printf("\n");
+    }
+
+    const char* bakedFilename = "benchmark.tex";
+    if (!baked.Save(bakedFilename)) {
+        printf("  cannot write %s\n", bakedFilename);
+        return;
+    }
+
+    // Mapping alone does not read anything, so every page is touched as the upload would.
+    unsigned int checksum = 0;
+
+    double start = GetTime();
+    for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+        TextureFile file;
+        file.Open(bakedFilename);
+
+        const unsigned char* data = file.GetData();
+        for (size_t i = 0; i < file.GetHeader().DataSize; i += 4096) {
+            checksum += data[i];
+        }
+    }
+    double time = (GetTime() - start) / iterations;
+
+    remove(bakedFilename);
+
+    printf("  baked bc1 container mapped: %7.3f ms (%.0fx faster than decoding, checksum %u)\n",
+        time * 1000.0, bakedDecodeTime / time, checksum);
+}
+
+void Benchmark::RunChunkDimensions() {
+    printf("Chunk dimensions (VoxelStorage and CpuMesher per layout, 1 thread, same voxel volume per size)\n");
+
+    MeasureChunkLayout<ChunkLayout<32, 8>>();
+    MeasureChunkLayout<ChunkLayout<64, 8>>();
+    MeasureChunkLayout<ChunkLayout<80, 8>>();
+    MeasureChunkLayout<ChunkLayout<128, 8>>();
+}
+
+template <typename Layout>
+void Benchmark::MeasureChunkLayout() const {
+    constexpr unsigned int size = Layout::ChunkSize;
+
+    // Every size processes about as many voxels as 16 chunks of 80^3, so the rates are comparable.
+    const unsigned int iterations = (16 * 80 * 80 * 80 + Layout::VoxelCount - 1) / Layout::VoxelCount;
+
+    // The terrain of GenerateTerrain, scaled to the chunk height, written slab by slab like World::Generate.
+    VoxelStorage storage(Layout::VoxelCount);
+    std::vector<unsigned int> slab(size * size);
+
+    for (unsigned int z = 0; z < size; ++z) {
+        for (unsigned int x = 0; x < size; ++x) {
+            float height = size / 80.0f * (32.0f +
+                12.0f * Math::Sin(x * 0.04f) * Math::Cos(z * 0.035f) +
+                6.0f * Math::Sin((x + z) * 0.013f));
+
+            for (unsigned int y = 0; y < size; ++y) {
+                slab[x + size * y] = y < height - 4.0f ? 2 : (y < height ? 1 : 0);
+            }
+        }
+
+        storage.Write(Layout::Index(0, 0, z), size * size, slab.data());
+    }
+
+    // Open sky everywhere, the light only ends up in the vertices.
+    std::vector<unsigned char> light(Layout::VoxelCount, 0xF0);
+
+    // The meshers of the game compiled for this layout, decoding included, on the calling thread only.
+    BasicCpuMesher<Layout> mesher;
+    CpuMesh mesh;
+
+    double start = GetTime();
+    for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+        mesher.Mesh(storage, light.data(), mesh, MeshingMode::Culled);
+    }
+    double meshTime = (GetTime() - start) / iterations;
+
+    const unsigned int faceCount = (unsigned int)mesh.Indices.size() / 6;
+
+    start = GetTime();
+    for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+        mesher.Mesh(storage, light.data(), mesh, MeshingMode::Binary);
+    }
+    double binaryTime = (GetTime() - start) / iterations;
+
+    const bool facesMatch = mesh.Indices.size() / 6 == faceCount;
+
+    // Spheres of radius 4 carved and filled at random, a row at a time like Chunk::UpdateRegion, marking the
+    // touched sub-chunks like Chunk::MarkDirty.
+    const unsigned int editCount = 4096;
+    const int radius = 4;
+    std::bitset<Layout::SubChunkCount> dirtySubChunks;
+    unsigned long long editedVoxels = 0;
+
+    srand(1);
+
+    start = GetTime();
+    for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+        for (unsigned int edit = 0; edit < editCount; ++edit) {
+            const int centerX = rand() % size;
+            const int centerY = rand() % size;
+            const int centerZ = rand() % size;
+            const unsigned int value = edit & 1 ? 2 : 0;
+
+            const int minX = Math::Max(centerX - radius, 0);
+            const int maxX = Math::Min(centerX + radius, (int)size - 1);
+
+            for (int z = Math::Max(centerZ - radius, 0); z <= Math::Min(centerZ + radius, (int)size - 1); ++z) {
+                for (int y = Math::Max(centerY - radius, 0); y <= Math::Min(centerY + radius, (int)size - 1); ++y) {
+                    const int dy = y - centerY;
+                    const int dz = z - centerZ;
+
+                    storage.Update(Layout::Index(minX, y, z), maxX - minX + 1, [&](unsigned int offset, unsigned int current) {
+                        const int x = minX + (int)offset;
+                        const int dx = x - centerX;
+                        if (dx * dx + dy * dy + dz * dz > radius * radius) {
+                            return current;
+                        }
+
+                        dirtySubChunks.set(Layout::SubChunkIndex(x, y, z));
+                        ++editedVoxels;
+                        return value;
+                    });
+                }
+            }
+        }
+
+        dirtySubChunks.reset();
+    }
+    double editTime = GetTime() - start;
+
+    // Index to coordinates over the whole chunk, what to3D does on the GPU.
+    unsigned long long coordinateSum = 0;
+
+    start = GetTime();
+    for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+        for (unsigned int index = 0; index < Layout::VoxelCount; ++index) {
+            unsigned int x, y, z;
+            Layout::Coordinates(index, x, y, z);
+            coordinateSum += x + y + z;
+        }
+    }
+    double coordinateTime = (GetTime() - start) / iterations;
+
+    const unsigned long long expectedSum = 3ull * iterations * Layout::VoxelCount * (size - 1) / 2;
+
+    printf("  %3u^3 %-14s culled %7.3f ms (%7.1f MVox/s, %7u faces), binary %7.3f ms (%7.1f MVox/s), edits %7.1f MVox/s, "
+        "coordinates %7.1f MVox/s%s%s\n",
+        size, Layout::PowerOfTwo ? "(shift/mask)" : "(mul/div)", meshTime * 1000.0, Layout::VoxelCount / meshTime * 1e-6, faceCount,
+        binaryTime * 1000.0, Layout::VoxelCount / binaryTime * 1e-6, editedVoxels / editTime * 1e-6, Layout::VoxelCount / coordinateTime * 1e-6,
+        facesMatch ? "" : " (face mismatch)", coordinateSum == expectedSum ? "" : " (coordinate mismatch)");
+}
+
+void Benchmark::RunJobSystem() {
+    const unsigned int iterations = 20;
+    const unsigned int count = 4096;
+
+    ThreadPool singleThread(0);
+    ThreadPool threadPool(std::max(ThreadPool::DefaultThreadCount(), 1u));
+    ThreadPool* threadPools[] = { &singleThread, &threadPool };
+
+    // Busy work of a given number of steps, seeded so it cannot be folded into a constant.
+    auto work = [](unsigned int seed, unsigned int steps) {
+        unsigned int value = seed;
+        for (unsigned int i = 0; i < steps; ++i) {
+            value = value * 1664525u + 1013904223u;
+        }
+        return value;
+    };
+
+    printf("Job system (%u indices, %u iterations)\n", count, iterations);
+
+    for (ThreadPool* pool : threadPools) {
+        std::atomic<unsigned int> checksum(0);
+
+        // Even work, and uneven work where every 64th index costs as much as all others together, which only
+        // spreads out if the threads that finish early steal.
+        double start = GetTime();
+        for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+            pool->ParallelFor(count, [&](unsigned int i) { checksum += work(i, 1000); });
+        }
+        double evenTime = (GetTime() - start) / iterations;
+
+        start = GetTime();
+        for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+            pool->ParallelFor(count, [&](unsigned int i) { checksum += work(i, i % 64 == 0 ? 64000 : 1000); });
+        }
+        double unevenTime = (GetTime() - start) / iterations;
+
+        // Fork/join overhead: indices that do nothing.
+        start = GetTime();
+        for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+            pool->ParallelFor(count, [&](unsigned int i) { checksum += i; });
+        }
+        double emptyTime = (GetTime() - start) / iterations;
+
+        // A chain of stages, each a batch of jobs that waits for the one before it.
+        const unsigned int stageCount = 16;
+        const unsigned int stageJobs = 64;
+
+        start = GetTime();
+        for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+            std::vector<JobCounter> stages(stageCount);
+            for (unsigned int stage = 0; stage < stageCount; ++stage) {
+                for (unsigned int job = 0; job < stageJobs; ++job) {
+                    pool->Submit([&, job]() { checksum += work(job, 1000); }, &stages[stage], stage > 0 ? &stages[stage - 1] : nullptr);
+                }
+            }
+
+            for (JobCounter& stage : stages) {
+                pool->Wait(stage);
+            }
+        }
+        double chainTime = (GetTime() - start) / iterations;
+
+        printf("  %2u threads: even %7.2f ms | uneven %7.2f ms | empty %6.3f ms (%5.1f ns per index) | %u x %u dependent jobs %7.2f ms\n",
+            pool->GetThreadCount(), evenTime * 1000.0, unevenTime * 1000.0, emptyTime * 1000.0, emptyTime / count * 1e9,
+            stageCount, stageJobs, chainTime * 1000.0);
+    }
+}
+
+void Benchmark::GenerateTerrain(Chunk& chunk) const {
+    std::vector<unsigned int> slab(Chunk::ChunkSize * Chunk::ChunkSize);
+
+    for (unsigned int z = 0; z < Chunk::ChunkSize; ++z) {
+        for (unsigned int x = 0; x < Chunk::ChunkSize; ++x) {
+            float height = 32.0f +
+                12.0f * Math::Sin(x * 0.04f) * Math::Cos(z * 0.035f) +
+                6.0f * Math::Sin((x + z) * 0.013f);
+
+            for (unsigned int y = 0; y < Chunk::ChunkSize; ++y) {
+                slab[x + Chunk::ChunkSize * y] = y < height - 4.0f ? 2 : (y < height ? 1 : 0);
+            }
+        }
+
+        chunk.SetVoxels(0, 0, z, Chunk::ChunkSize, Chunk::ChunkSize, 1, slab.data());
+    }
+}
+
+double Benchmark::GetTime() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
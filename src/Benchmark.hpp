@@ -0,0 +1,39 @@
+#pragma once 
+
+class Chunk;
+
+class Benchmark {
+public:
+    void Run();
+
+private:
+    void RunVoxelStorage();
+
+    void RunBulkWrites();
+
+    void RunMeshing();
+
+    void RunGreedyMeshing();
+
+    void RunBinaryMeshing();
+
+    void RunLevelOfDetail();
+
+    void RunAmbientOcclusion();
+
+    void RunLightPropagation();
+
+    void RunTextureDecoding();
+
+    void RunChunkDimensions();
+
+    void RunJobSystem();
+
+    // Meshes and edits a VoxelStorage laid out by the given ChunkLayout with BasicCpuMesher, see RunChunkDimensions.
+    template <typename Layout>
+    void MeasureChunkLayout() const;
+
+    void GenerateTerrain(Chunk& chunk) const;
+
+    double GetTime() const;
+};
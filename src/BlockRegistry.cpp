@@ -0,0 +1,51 @@
+#include "BlockRegistry.hpp"
+
+#include <algorithm>
+
+BlockRegistry::BlockRegistry() {
+    std::fill(mLayers, mLayers + MaxBlocks * 6, 0u);
+}
+
+BlockRegistry::~BlockRegistry() {
+    if (mBufferId) {
+        glDeleteBuffers(1, &mBufferId);
+    }
+}
+
+void BlockRegistry::Register(unsigned int value, unsigned int layer) {
+    Register(value, layer, layer, layer);
+}
+
+void BlockRegistry::Register(unsigned int value, unsigned int topLayer, unsigned int bottomLayer, unsigned int sideLayer) {
+    if (value >= MaxBlocks) {
+        return;
+    }
+
+    unsigned int* layers = mLayers + value * 6;
+    layers[0] = sideLayer;
+    layers[1] = sideLayer;
+    layers[2] = topLayer;
+    layers[3] = bottomLayer;
+    layers[4] = sideLayer;
+    layers[5] = sideLayer;
+
+    mBufferDirty = true;
+}
+
+unsigned int BlockRegistry::GetLayer(unsigned int value, unsigned int face) const {
+    return value < MaxBlocks ? mLayers[value * 6 + face] : 0;
+}
+
+GLuint BlockRegistry::GetBufferId() const {
+    if (!mBufferId) {
+        glCreateBuffers(1, &mBufferId);
+        glNamedBufferStorage(mBufferId, sizeof(mLayers), 0, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    if (mBufferDirty) {
+        glNamedBufferSubData(mBufferId, 0, sizeof(mLayers), mLayers);
+        mBufferDirty = false;
+    }
+
+    return mBufferId;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// Texture array layer of every face of every voxel value, faces in the order +X -X +Y -Y +Z -Z. The meshers
+// write the layer into the vertex material instead of the voxel value, so blocks can look different per face
+// and different values can share a texture. Values without an entry, or at or above MaxBlocks, use layer 0.
+// Blocks should be registered before chunks are meshed; existing meshes are not rebuilt.
+class BlockRegistry {
+public:
+    static constexpr unsigned int MaxBlocks = 256;
+
+public:
+    BlockRegistry();
+
+    ~BlockRegistry();
+
+    void Register(unsigned int value, unsigned int layer);
+
+    void Register(unsigned int value, unsigned int topLayer, unsigned int bottomLayer, unsigned int sideLayer);
+
+    unsigned int GetLayer(unsigned int value, unsigned int face) const;
+
+    // The layers of all MaxBlocks values, six per value, for voxelizer.comp. Created and updated on demand,
+    // so a registry that is only used by CpuMesher never touches OpenGL.
+    GLuint GetBufferId() const;
+
+private:
+    unsigned int mLayers[MaxBlocks * 6];
+    mutable GLuint mBufferId = 0;
+    mutable bool mBufferDirty = true;
+};
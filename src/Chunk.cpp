@@ -1,82 +1,314 @@
 #include "Chunk.hpp"
+#include "CpuMesher.hpp"
 #include "Math.hpp"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
-Chunk::Chunk() {
-    glCreateBuffers(1, &mVoxelBufferId);
-    glNamedBufferStorage(mVoxelBufferId, sizeof(unsigned int) * ChunkSize * ChunkSize * ChunkSize, 0, GL_MAP_COHERENT_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+#include <algorithm>
+#include <vector>
 
-    mVoxels = (unsigned int*)glMapNamedBuffer(mVoxelBufferId, GL_READ_WRITE);
+// Starting capacity of a chunk mesh; a typical surface chunk fits, and the allocation is trimmed to the real
+// size once the feedback has been read back.
+static constexpr unsigned int InitialVertexCount = 128 * 1024;
+static constexpr unsigned int InitialIndexCount = InitialVertexCount * 3 / 2;
 
-    memset(mVoxels, 0, sizeof(unsigned int) * ChunkSize * ChunkSize * ChunkSize);
+// Allocations are not trimmed below this, so that nearly empty chunks do not get reallocated over and over.
+static constexpr unsigned int MinimumVertexCount = 256;
 
-    glCreateBuffers(1, &mChunkFeedbackBufferId);
-    glNamedBufferStorage(mChunkFeedbackBufferId, sizeof(ChunkFeedback), 0,
-        GL_MAP_COHERENT_BIT | GL_MAP_PERSISTENT_BIT | GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+ShaderDefines Chunk::GetShaderDefines() {
+    return Layout::GetShaderDefines();
+}
 
-    glCreateBuffers(1, &mSubChunkFeedbackBufferId);
-    glNamedBufferStorage(mSubChunkFeedbackBufferId, sizeof(SubChunkFeedback) * SubChunkSize * SubChunkSize * SubChunkSize, 0, 0);
+Chunk::Chunk(const Vector3& origin, MeshHeap* meshHeap, ThreadPool* threadPool)
+    : mOrigin(origin), mStorage(VoxelCount), mLight(VoxelCount, 0), mMeshHeap(meshHeap), mThreadPool(threadPool) {
+}
 
-    glCreateVertexArrays(1, &mVertexArrayObjectId);
+Chunk::~Chunk() {
+    WaitForLevel();
 
-    glEnableVertexArrayAttrib(mVertexArrayObjectId, 0);
-    glEnableVertexArrayAttrib(mVertexArrayObjectId, 1);
-    glEnableVertexArrayAttrib(mVertexArrayObjectId, 2);
+    if (mFeedbackFence) {
+        glDeleteSync(mFeedbackFence);
+    }
 
-    glVertexArrayAttribFormat(mVertexArrayObjectId, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
-    glVertexArrayAttribFormat(mVertexArrayObjectId, 1, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, UV));
-    glVertexArrayAttribFormat(mVertexArrayObjectId, 2, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal));
+    if (mVoxelBufferId) {
+        mMeshHeap->Free(mAllocation);
 
-    glVertexArrayAttribBinding(mVertexArrayObjectId, 0, 0);
-    glVertexArrayAttribBinding(mVertexArrayObjectId, 1, 0);
-    glVertexArrayAttribBinding(mVertexArrayObjectId, 2, 0);
+        glDeleteBuffers(1, &mSubChunkListBufferId);
+        glDeleteBuffers(1, &mChunkFeedbackBufferId);
+        glDeleteBuffers(1, &mLightBufferId);
+        glDeleteBuffers(1, &mVoxelBufferId);
+    }
 }
 
-Chunk::~Chunk() {
-    glUnmapNamedBuffer(mVoxelBufferId);
+unsigned int Chunk::GetVoxel(unsigned int x, unsigned int y, unsigned int z) const {
+    if (x < ChunkSize && y < ChunkSize && z < ChunkSize) {
+        return mStorage.GetVoxel(Layout::Index(x, y, z));
+    }
 
-    glDeleteBuffers(1, &mIndexBufferId);
-    glDeleteBuffers(1, &mVertexBufferId);
-    glDeleteVertexArrays(1, &mVertexArrayObjectId);
-    glDeleteBuffers(1, &mSubChunkFeedbackBufferId);
-    glDeleteBuffers(1, &mChunkFeedbackBufferId);
+    return 0;
 }
 
 void Chunk::SetVoxel(unsigned int x, unsigned int y, unsigned int z, unsigned int value) {
-    unsigned int index = x + ChunkSize * (y + ChunkSize * z);
+    if (x < ChunkSize && y < ChunkSize && z < ChunkSize) {
+        WaitForLevel();
 
-    if (index < ChunkSize * ChunkSize * ChunkSize) {
-        if (mVoxels[index] != value) {
-            mVoxels[index] = value;
-            mDirty = true;
+        if (mStorage.SetVoxel(Layout::Index(x, y, z), value)) {
+            MarkDirty(x, y, z);
         }
     }
 }
 
-void Chunk::Render(Shader* feedbackShader, Shader* voxelizerShader, Shader* forwardShader) {
+void Chunk::FillRegion(unsigned int minX, unsigned int minY, unsigned int minZ, unsigned int maxX, unsigned int maxY, unsigned int maxZ, unsigned int value) {
+    maxX = maxX < ChunkSize ? maxX : ChunkSize;
+    maxY = maxY < ChunkSize ? maxY : ChunkSize;
+    maxZ = maxZ < ChunkSize ? maxZ : ChunkSize;
+
+    if (minX >= maxX || minY >= maxY || minZ >= maxZ) {
+        return;
+    }
+
+    WaitForLevel();
+
+    bool changed = false;
+
+    if (minX == 0 && maxX == ChunkSize && minY == 0 && maxY == ChunkSize) {
+        changed = mStorage.Fill(ChunkSize * ChunkSize * minZ, ChunkSize * ChunkSize * (maxZ - minZ), value);
+    }
+    else if (minX == 0 && maxX == ChunkSize) {
+        for (unsigned int z = minZ; z < maxZ; ++z) {
+            changed |= mStorage.Fill(Layout::Index(0, minY, z), ChunkSize * (maxY - minY), value);
+        }
+    }
+    else {
+        for (unsigned int z = minZ; z < maxZ; ++z) {
+            for (unsigned int y = minY; y < maxY; ++y) {
+                changed |= mStorage.Fill(Layout::Index(minX, y, z), maxX - minX, value);
+            }
+        }
+    }
+
+    if (changed) {
+        MarkDirty(minX, minY, minZ, maxX, maxY, maxZ);
+    }
+}
+
+void Chunk::SetVoxels(unsigned int x, unsigned int y, unsigned int z, unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ, const unsigned int* values) {
+    unsigned int maxX = x + sizeX < ChunkSize ? x + sizeX : ChunkSize;
+    unsigned int maxY = y + sizeY < ChunkSize ? y + sizeY : ChunkSize;
+    unsigned int maxZ = z + sizeZ < ChunkSize ? z + sizeZ : ChunkSize;
+
+    if (x >= maxX || y >= maxY || z >= maxZ) {
+        return;
+    }
+
+    WaitForLevel();
+
+    bool changed = false;
+
+    if (x == 0 && sizeX == ChunkSize && y == 0 && sizeY == ChunkSize) {
+        changed = mStorage.Write(ChunkSize * ChunkSize * z, ChunkSize * ChunkSize * (maxZ - z), values);
+    }
+    else {
+        for (unsigned int rz = z; rz < maxZ; ++rz) {
+            for (unsigned int ry = y; ry < maxY; ++ry) {
+                const unsigned int* row = values + sizeX * ((ry - y) + sizeY * (rz - z));
+                changed |= mStorage.Write(Layout::Index(x, ry, rz), maxX - x, row);
+            }
+        }
+    }
+
+    if (changed) {
+        MarkDirty(x, y, z, maxX, maxY, maxZ);
+    }
+}
+
+void Chunk::UpdateMesh(Shader* feedbackShader, Shader* voxelizerShader, CpuMesher* mesher) {
+    if (mFeedbackFence) {
+        ReadFeedback();
+    }
+
     if (mDirty) {
-        Regenerate(feedbackShader, voxelizerShader);
+        if (!mVoxelBufferId) {
+            CreateResources();
+        }
+
+        if (mMeshingMode != MeshingMode::Culled && mesher) {
+            Upload(mesher);
+        }
+        else {
+            if (mLevel > 0 && mBuiltLevel != mLevel && mLevelJob.IsDone()) {
+                BuildLevel();
+            }
+
+            // The old mesh stays until the job has reduced the level.
+            if (!mLevelJob.IsDone()) {
+                return;
+            }
+
+            Regenerate(feedbackShader, voxelizerShader);
+        }
+
         mDirty = false;
     }
+}
 
-    if (mVertexArrayObjectId && mChunkFeedback.indexCount > 0) {
-        glBindProgramPipeline(forwardShader->GetId());
+void Chunk::SetMeshingMode(MeshingMode mode) {
+    if (mMeshingMode == mode) {
+        return;
+    }
+
+    // Both paths share the vertex and index buffers but lay them out differently, so switching
+    // always rebuilds the whole chunk.
+    mMeshingMode = mode;
+    mFullRegeneration = true;
+    mDirty = true;
+}
+
+MeshingMode Chunk::GetMeshingMode() const {
+    return mMeshingMode;
+}
+
+void Chunk::SetLevel(unsigned int level) {
+    level = level < LevelCount ? level : LevelCount - 1;
 
-        glBindVertexArray(mVertexArrayObjectId);
+    if (mLevel == level) {
+        return;
+    }
+
+    mLevel = level;
+    mFullRegeneration = true;
+    mDirty = true;
+
+    // Full resolution is decoded straight from the storage.
+    if (mLevel == 0) {
+        WaitForLevel();
 
-        glDrawElements(GL_TRIANGLES, mChunkFeedback.indexCount, GL_UNSIGNED_INT, NULL);
+        std::vector<unsigned int>().swap(mLevelVoxels);
+        std::vector<unsigned char>().swap(mLevelLight);
+        mBuiltLevel = 0;
     }
 }
 
-GLuint Chunk::GetChunkFeedbackBufferId() const {
-    return mChunkFeedbackBufferId;
+unsigned int Chunk::GetLevel() const {
+    return mLevel;
+}
+
+void Chunk::DecodeLevel(unsigned int level, unsigned int* voxels) const {
+    mStorage.Decode(0, VoxelCount, voxels);
+
+    // Every block is read from twice its coordinates, at or past the voxel it is written to, so the levels
+    // are reduced in place.
+    unsigned int size = ChunkSize;
+
+    for (unsigned int step = 0; step < level && step + 1 < LevelCount; ++step) {
+        size /= 2;
+
+        for (unsigned int z = 0; z < size; ++z) {
+            for (unsigned int y = 0; y < size; ++y) {
+                for (unsigned int x = 0; x < size; ++x) {
+                    unsigned int values[8];
+                    unsigned int solidCount = 0;
+
+                    for (unsigned int i = 0; i < 8; ++i) {
+                        unsigned int value = voxels[Layout::Index(2 * x + (i & 1), 2 * y + ((i >> 1) & 1), 2 * z + (i >> 2))];
+                        if (value) {
+                            values[solidCount++] = value;
+                        }
+                    }
+
+                    unsigned int result = 0;
+
+                    if (solidCount >= 4) {
+                        unsigned int bestCount = 0;
+
+                        for (unsigned int i = 0; i < solidCount; ++i) {
+                            unsigned int count = (unsigned int)std::count(values, values + solidCount, values[i]);
+                            if (count > bestCount) {
+                                bestCount = count;
+                                result = values[i];
+                            }
+                        }
+                    }
+
+                    voxels[Layout::Index(x, y, z)] = result;
+                }
+            }
+        }
+    }
+
+    if (size == ChunkSize) {
+        return;
+    }
+
+    for (unsigned int z = 0; z < ChunkSize; ++z) {
+        for (unsigned int y = 0; y < ChunkSize; ++y) {
+            unsigned int* row = voxels + Layout::Index(0, y, z);
+            unsigned int first = y < size && z < size ? size : 0;
+
+            std::fill(row + first, row + ChunkSize, 0u);
+        }
+    }
+}
+
+void Chunk::DecodeLightLevel(unsigned int level, unsigned char* light) const {
+    memcpy(light, mLight.data(), VoxelCount);
+
+    unsigned int size = ChunkSize;
+
+    for (unsigned int step = 0; step < level && step + 1 < LevelCount; ++step) {
+        size /= 2;
+
+        for (unsigned int z = 0; z < size; ++z) {
+            for (unsigned int y = 0; y < size; ++y) {
+                for (unsigned int x = 0; x < size; ++x) {
+                    unsigned int block = 0;
+                    unsigned int sky = 0;
+
+                    for (unsigned int i = 0; i < 8; ++i) {
+                        unsigned int value = light[Layout::Index(2 * x + (i & 1), 2 * y + ((i >> 1) & 1), 2 * z + (i >> 2))];
+                        block = std::max(block, value & 0xF);
+                        sky = std::max(sky, value >> 4);
+                    }
+
+                    light[Layout::Index(x, y, z)] = (unsigned char)(block | (sky << 4));
+                }
+            }
+        }
+    }
+
+    if (size == ChunkSize) {
+        return;
+    }
+
+    // Past the level's corner lies what would be the neighbouring chunks, which count as open sky.
+    for (unsigned int z = 0; z < ChunkSize; ++z) {
+        for (unsigned int y = 0; y < ChunkSize; ++y) {
+            unsigned char* row = light + Layout::Index(0, y, z);
+            unsigned int first = y < size && z < size ? size : 0;
+
+            std::fill(row + first, row + ChunkSize, (unsigned char)0xF0);
+        }
+    }
+}
+
+unsigned char* Chunk::GetLight() {
+    WaitForLevel();
+
+    return mLight.data();
+}
+
+const unsigned char* Chunk::GetLight() const {
+    return mLight.data();
 }
 
-GLuint Chunk::GetSubChunkFeedbackBufferId() const {
-    return mSubChunkFeedbackBufferId;
+void Chunk::InvalidateLight(unsigned int minX, unsigned int minY, unsigned int minZ, unsigned int maxX, unsigned int maxY, unsigned int maxZ) {
+    MarkDirty(minX, minY, minZ, maxX, maxY, maxZ);
+}
+
+GLuint Chunk::GetChunkFeedbackBufferId() const {
+    return mChunkFeedbackBufferId;
 }
 
 const ChunkFeedback& Chunk::GetChunkFeedback() const {
@@ -87,63 +319,336 @@ const SubChunkFeedback* Chunk::GetSubChunkFeedbacks() const {
     return mSubChunkFeedbacks;
 }
 
+const VoxelStorage& Chunk::GetStorage() const {
+    return mStorage;
+}
+
+const Vector3& Chunk::GetOrigin() const {
+    return mOrigin;
+}
+
+const std::bitset<Chunk::SubChunkCount>& Chunk::GetDirtySubChunks() const {
+    return mDirtySubChunks;
+}
+
+bool Chunk::IsDirty() const {
+    return mDirty || mFeedbackFence;
+}
+
+void Chunk::CreateResources() {
+    glCreateBuffers(1, &mVoxelBufferId);
+    glNamedBufferStorage(mVoxelBufferId, sizeof(unsigned int) * VoxelCount, 0, GL_MAP_WRITE_BIT);
+
+    glCreateBuffers(1, &mLightBufferId);
+    glNamedBufferStorage(mLightBufferId, VoxelCount, 0, GL_MAP_WRITE_BIT);
+
+    glCreateBuffers(1, &mChunkFeedbackBufferId);
+    glNamedBufferStorage(mChunkFeedbackBufferId, sizeof(ChunkFeedback), 0,
+        GL_MAP_COHERENT_BIT | GL_MAP_PERSISTENT_BIT | GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+
+    glCreateBuffers(1, &mSubChunkListBufferId);
+    glNamedBufferStorage(mSubChunkListBufferId, sizeof(GLuint) * SubChunkCount, 0, GL_DYNAMIC_STORAGE_BIT);
+
+    mMappedChunkFeedback = (const ChunkFeedback*)glMapNamedBufferRange(mChunkFeedbackBufferId, 0, sizeof(ChunkFeedback),
+        GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+
+    Reallocate(InitialVertexCount, InitialIndexCount, false);
+}
+
+void Chunk::MarkDirty(unsigned int x, unsigned int y, unsigned int z) {
+    const unsigned int coord[3] = { x / WorkGroupSize, y / WorkGroupSize, z / WorkGroupSize };
+    const unsigned int local[3] = { x % WorkGroupSize, y % WorkGroupSize, z % WorkGroupSize };
+    const unsigned int stride[3] = { 1, SubChunkSize, SubChunkSize * SubChunkSize };
+
+    unsigned int index = coord[0] + SubChunkSize * (coord[1] + SubChunkSize * coord[2]);
+    mDirtySubChunks.set(index);
+
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        if (local[axis] == 0 && coord[axis] > 0) {
+            mDirtySubChunks.set(index - stride[axis]);
+        }
+
+        if (local[axis] == WorkGroupSize - 1 && coord[axis] < SubChunkSize - 1) {
+            mDirtySubChunks.set(index + stride[axis]);
+        }
+    }
+
+    mBuiltLevel = 0;
+    mDirty = true;
+}
+
+void Chunk::MarkDirty(unsigned int minX, unsigned int minY, unsigned int minZ, unsigned int maxX, unsigned int maxY, unsigned int maxZ) {
+    unsigned int firstX = (minX > 0 ? minX - 1 : 0) / WorkGroupSize;
+    unsigned int firstY = (minY > 0 ? minY - 1 : 0) / WorkGroupSize;
+    unsigned int firstZ = (minZ > 0 ? minZ - 1 : 0) / WorkGroupSize;
+    unsigned int lastX = (maxX < ChunkSize ? maxX : ChunkSize - 1) / WorkGroupSize;
+    unsigned int lastY = (maxY < ChunkSize ? maxY : ChunkSize - 1) / WorkGroupSize;
+    unsigned int lastZ = (maxZ < ChunkSize ? maxZ : ChunkSize - 1) / WorkGroupSize;
+
+    for (unsigned int z = firstZ; z <= lastZ; ++z) {
+        for (unsigned int y = firstY; y <= lastY; ++y) {
+            for (unsigned int x = firstX; x <= lastX; ++x) {
+                mDirtySubChunks.set(x + SubChunkSize * (y + SubChunkSize * z));
+            }
+        }
+    }
+
+    mBuiltLevel = 0;
+    mDirty = true;
+}
+
+void Chunk::BuildLevel() {
+    mLevelVoxels.resize(VoxelCount);
+    mLevelLight.resize(VoxelCount);
+    mBuiltLevel = mLevel;
+
+    const unsigned int level = mLevel;
+    auto build = [this, level]() {
+        DecodeLevel(level, mLevelVoxels.data());
+        DecodeLightLevel(level, mLevelLight.data());
+    };
+
+    if (mThreadPool) {
+        mThreadPool->Submit(build, &mLevelJob);
+    }
+    else {
+        build();
+    }
+}
+
+void Chunk::WaitForLevel() {
+    if (!mLevelJob.IsDone()) {
+        mThreadPool->Wait(mLevelJob);
+    }
+}
+
 void Chunk::Regenerate(Shader* feedbackShader, Shader* voxelizerShader) const {
-    mChunkFeedback = ChunkFeedback();
+    // Coarser levels are cheap to mesh and far away from any edits, so they are always rebuilt as a whole.
+    const bool fullRegeneration = mFullRegeneration || mLevel > 0;
+    if (fullRegeneration) {
+        mDirtySubChunks.set();
+    }
+
+    // Sub-chunks past the corner occupied by the level are empty.
+    const unsigned int levelSubChunkSize = ((ChunkSize >> mLevel) + WorkGroupSize - 1) / WorkGroupSize;
+
+    GLuint subChunkList[SubChunkCount];
+    unsigned int subChunkCount = 0;
+    unsigned int firstSlab = SubChunkSize;
+    unsigned int lastSlab = 0;
+
+    for (unsigned int i = 0; i < SubChunkCount; ++i) {
+        if (mDirtySubChunks[i] && i % SubChunkSize < levelSubChunkSize && i / SubChunkSize % SubChunkSize < levelSubChunkSize &&
+            i / (SubChunkSize * SubChunkSize) < levelSubChunkSize) {
+            unsigned int slab = i / (SubChunkSize * SubChunkSize);
+
+            firstSlab = (unsigned int)Math::Min((int)firstSlab, (int)slab);
+            lastSlab = (unsigned int)Math::Max((int)lastSlab, (int)slab);
 
-    ChunkFeedback* feedback = (ChunkFeedback*)glMapNamedBuffer(mChunkFeedbackBufferId, GL_WRITE_ONLY);
-    *feedback = mChunkFeedback;
-    glUnmapNamedBuffer(mChunkFeedbackBufferId);
+            subChunkList[subChunkCount++] = i;
+        }
+    }
+
+    mDirtySubChunks.reset();
+
+    if (subChunkCount == 0) {
+        return;
+    }
+
+    const unsigned int slabVoxelCount = ChunkSize * ChunkSize * WorkGroupSize;
+    const unsigned int firstVoxel = firstSlab * slabVoxelCount;
+    const unsigned int voxelCount = (lastSlab - firstSlab + 1) * slabVoxelCount;
+
+    if (mLevel == 0) {
+        unsigned int* voxels = (unsigned int*)glMapNamedBufferRange(mVoxelBufferId, sizeof(unsigned int) * firstVoxel, sizeof(unsigned int) * voxelCount, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        mStorage.Decode(firstVoxel, voxelCount, voxels);
+        glUnmapNamedBuffer(mVoxelBufferId);
+
+        unsigned char* light = (unsigned char*)glMapNamedBufferRange(mLightBufferId, firstVoxel, voxelCount, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        memcpy(light, mLight.data() + firstVoxel, voxelCount);
+        glUnmapNamedBuffer(mLightBufferId);
+    }
+    else {
+        // Reduced by BuildLevel ahead of time, only the upload is left.
+        unsigned int* voxels = (unsigned int*)glMapNamedBufferRange(mVoxelBufferId, 0, sizeof(unsigned int) * VoxelCount, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        memcpy(voxels, mLevelVoxels.data(), sizeof(unsigned int) * VoxelCount);
+        glUnmapNamedBuffer(mVoxelBufferId);
+
+        unsigned char* light = (unsigned char*)glMapNamedBufferRange(mLightBufferId, 0, VoxelCount, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        memcpy(light, mLevelLight.data(), VoxelCount);
+        glUnmapNamedBuffer(mLightBufferId);
+    }
+
+    glNamedBufferSubData(mSubChunkListBufferId, 0, sizeof(GLuint) * subChunkCount, subChunkList);
+
+    if (fullRegeneration) {
+        glClearNamedBufferSubData(mMeshHeap->GetSubChunkFeedbackBufferId(mAllocation.Page), GL_R32UI,
+            sizeof(SubChunkFeedback) * SubChunkCount * mAllocation.DrawSlot, sizeof(SubChunkFeedback) * SubChunkCount,
+            GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+        // Also switches chunks coming from a CPU meshing mode back to per sub-chunk culling.
+        mMeshHeap->SetDraw(mAllocation, 0, mOrigin, DrawRanges::SubChunks, mLevel);
+
+        mChunkFeedback.vertexCount = 0;
+        mChunkFeedback.indexCount = 0;
+        mChunkFeedback.vertexTail = 0;
+        mChunkFeedback.indexTail = 0;
+        mChunkFeedback.overflow = 0;
+
+        glNamedBufferSubData(mChunkFeedbackBufferId, 0, sizeof(ChunkFeedback), &mChunkFeedback);
+    }
 
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mVoxelBufferId);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mLightBufferId);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, mMeshHeap->GetVertexBufferId(mAllocation.Page),
+        sizeof(Vertex) * mAllocation.VertexOffset, sizeof(Vertex) * mAllocation.VertexCount);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 3, mMeshHeap->GetIndexBufferId(mAllocation.Page),
+        sizeof(GLuint) * mAllocation.IndexOffset, sizeof(GLuint) * mAllocation.IndexCount);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, mChunkFeedbackBufferId);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, mSubChunkFeedbackBufferId);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, mMeshHeap->GetSubChunkFeedbackBufferId(mAllocation.Page));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, mSubChunkListBufferId);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, mMeshHeap->GetDrawCommandBufferId(mAllocation.Page));
 
     glBindProgramPipeline(feedbackShader->GetId());
 
-    glDispatchCompute(SubChunkSize, SubChunkSize, SubChunkSize);
+    glProgramUniform1ui(feedbackShader->GetComputeProgramId(), 0, mAllocation.DrawSlot);
+
+    glDispatchCompute(subChunkCount, 1, 1);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Sub-chunks that no longer fit are skipped by the voxelizer; the overflow is picked up by ReadFeedback
+    // a few frames later instead of stalling here on the counts.
+    glBindProgramPipeline(voxelizerShader->GetId());
+
+    glProgramUniform1ui(voxelizerShader->GetComputeProgramId(), 0, mAllocation.DrawSlot);
+
+    glDispatchCompute(subChunkCount, 1, 1);
 
     glMemoryBarrier(GL_ALL_BARRIER_BITS);
 
-    feedback = (ChunkFeedback*)glMapNamedBuffer(mChunkFeedbackBufferId, GL_READ_ONLY);
-    mChunkFeedback = *feedback;
-    glUnmapNamedBuffer(mChunkFeedbackBufferId);
+    if (mFeedbackFence) {
+        glDeleteSync(mFeedbackFence);
+    }
+
+    mFeedbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mFullRegeneration = false;
+}
+
+void Chunk::ReadFeedback() const {
+    GLint status = GL_UNSIGNALED;
+    glGetSynciv(mFeedbackFence, GL_SYNC_STATUS, 1, NULL, &status);
+
+    if (status != GL_SIGNALED) {
+        return;
+    }
+
+    glDeleteSync(mFeedbackFence);
+    mFeedbackFence = 0;
 
-    int currentVertexBufferSize = 0;
-    if (mVertexBufferId) {
-        glGetNamedBufferParameteriv(mVertexBufferId, GL_BUFFER_SIZE, &currentVertexBufferSize);
+    mChunkFeedback = *mMappedChunkFeedback;
+
+    // Leave a quarter of headroom so that edits can grow sub-chunk slots in place.
+    const unsigned int vertexCount = Math::Max((int)(mChunkFeedback.vertexTail + mChunkFeedback.vertexTail / 4), (int)MinimumVertexCount);
+    const unsigned int indexCount = vertexCount * 3 / 2;
+
+    if (mChunkFeedback.overflow) {
+        // Whatever did not fit was never written, so the chunk is rebuilt from scratch in the larger ranges.
+        mChunkFeedback.overflow = 0;
+
+        Reallocate(vertexCount, Math::Max((int)indexCount, (int)mChunkFeedback.indexTail), false);
+
+        mFullRegeneration = true;
+        mDirty = true;
+        return;
     }
 
-    int currentIndexBufferSize = 0;
-    if (mIndexBufferId) {
-        glGetNamedBufferParameteriv(mIndexBufferId, GL_BUFFER_SIZE, &currentIndexBufferSize);
+    if (mAllocation.VertexCount > 2 * vertexCount && mAllocation.IndexCount > 2 * indexCount) {
+        Reallocate(vertexCount, indexCount, true);
     }
 
-    unsigned int newVertexBufferSize = mChunkFeedback.vertexCount * sizeof(Vertex);
-    unsigned int newIndexBufferSize = mChunkFeedback.indexCount * sizeof(GLuint);
+    if (mChunkFeedback.indexTail > 2 * mChunkFeedback.indexCount) {
+        mFullRegeneration = true;
+    }
+}
 
-    if (newVertexBufferSize > (unsigned int)currentVertexBufferSize) {
-        glDeleteBuffers(1, &mVertexBufferId);
+void Chunk::Upload(CpuMesher* mesher) const {
+    CpuMesh mesh;
+    mesher->Mesh(*this, mesh, mMeshingMode);
 
-        glCreateBuffers(1, &mVertexBufferId);
-        glNamedBufferStorage(mVertexBufferId, Math::Align(newVertexBufferSize, 32 * 1024 * 1024), 0, 0);
+    const unsigned int vertexCount = (unsigned int)mesh.Vertices.size();
+    const unsigned int indexCount = (unsigned int)mesh.Indices.size();
+
+    if (vertexCount > mAllocation.VertexCount || indexCount > mAllocation.IndexCount ||
+        (mAllocation.VertexCount > 2 * vertexCount && mAllocation.VertexCount > MinimumVertexCount)) {
+        Reallocate(Math::Max((int)vertexCount, (int)MinimumVertexCount), Math::Max((int)indexCount, (int)MinimumVertexCount * 3 / 2), false);
+    }
+
+    glNamedBufferSubData(mMeshHeap->GetVertexBufferId(mAllocation.Page), sizeof(Vertex) * mAllocation.VertexOffset,
+        sizeof(Vertex) * vertexCount, mesh.Vertices.data());
+    glNamedBufferSubData(mMeshHeap->GetIndexBufferId(mAllocation.Page), sizeof(GLuint) * mAllocation.IndexOffset,
+        sizeof(GLuint) * indexCount, mesh.Indices.data());
+
+    mChunkFeedback.vertexCount = vertexCount;
+    mChunkFeedback.indexCount = indexCount;
+    mChunkFeedback.vertexTail = vertexCount;
+    mChunkFeedback.indexTail = indexCount;
+    mChunkFeedback.overflow = 0;
+
+    // The culling pass finds the six direction ranges in the first sub-chunk records of the slot.
+    SubChunkFeedback faceRanges[6];
+    unsigned int faceIndexOffset = 0;
+
+    for (unsigned int face = 0; face < 6; ++face) {
+        faceRanges[face].indexOffset = faceIndexOffset;
+        faceRanges[face].indexCount = mesh.FaceIndexCounts[face];
+        faceIndexOffset += mesh.FaceIndexCounts[face];
     }
 
-    if (newIndexBufferSize > (unsigned int)currentIndexBufferSize) {
-        glDeleteBuffers(1, &mIndexBufferId);
+    glNamedBufferSubData(mMeshHeap->GetSubChunkFeedbackBufferId(mAllocation.Page), sizeof(SubChunkFeedback) * SubChunkCount * mAllocation.DrawSlot,
+        sizeof(faceRanges), faceRanges);
 
-        glCreateBuffers(1, &mIndexBufferId);
-        glNamedBufferStorage(mIndexBufferId, Math::Align(newIndexBufferSize, 32 * 1024 * 1024), 0, 0);
+    mMeshHeap->SetDraw(mAllocation, indexCount, mOrigin, DrawRanges::Whole, mLevel);
+
+    // Feedback from an earlier GPU regeneration would overwrite the counts above.
+    if (mFeedbackFence) {
+        glDeleteSync(mFeedbackFence);
+        mFeedbackFence = 0;
     }
 
-    glVertexArrayVertexBuffer(mVertexArrayObjectId, 0, mVertexBufferId, 0, sizeof(Vertex));
-    glVertexArrayElementBuffer(mVertexArrayObjectId, mIndexBufferId);
+    // The GPU sub-chunk slots no longer describe the buffers, so going back to Culled starts from scratch.
+    mDirtySubChunks.reset();
+    mFullRegeneration = true;
+}
 
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mVertexBufferId);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mIndexBufferId);
+void Chunk::Reallocate(unsigned int vertexCount, unsigned int indexCount, bool preserve) const {
+    MeshAllocation allocation;
+    if (!mMeshHeap->Allocate(vertexCount, indexCount, allocation)) {
+        return;
+    }
 
-    glBindProgramPipeline(voxelizerShader->GetId());
+    // Sub-chunk slots and indices are relative to the start of the ranges, so the mesh moves with a plain copy.
+    if (preserve && mAllocation.IsValid()) {
+        glCopyNamedBufferSubData(mMeshHeap->GetVertexBufferId(mAllocation.Page), mMeshHeap->GetVertexBufferId(allocation.Page),
+            sizeof(Vertex) * mAllocation.VertexOffset, sizeof(Vertex) * allocation.VertexOffset,
+            sizeof(Vertex) * Math::Min((int)mChunkFeedback.vertexTail, (int)vertexCount));
+        glCopyNamedBufferSubData(mMeshHeap->GetIndexBufferId(mAllocation.Page), mMeshHeap->GetIndexBufferId(allocation.Page),
+            sizeof(GLuint) * mAllocation.IndexOffset, sizeof(GLuint) * allocation.IndexOffset,
+            sizeof(GLuint) * Math::Min((int)mChunkFeedback.indexTail, (int)indexCount));
+        glCopyNamedBufferSubData(mMeshHeap->GetSubChunkFeedbackBufferId(mAllocation.Page), mMeshHeap->GetSubChunkFeedbackBufferId(allocation.Page),
+            sizeof(SubChunkFeedback) * SubChunkCount * mAllocation.DrawSlot, sizeof(SubChunkFeedback) * SubChunkCount * allocation.DrawSlot,
+            sizeof(SubChunkFeedback) * SubChunkCount);
+    }
 
-    glDispatchCompute(SubChunkSize, SubChunkSize, SubChunkSize);
+    mMeshHeap->Free(mAllocation);
+    mAllocation = allocation;
 
-    glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    mChunkFeedback.vertexCapacity = vertexCount;
+    mChunkFeedback.indexCapacity = indexCount;
+
+    glNamedBufferSubData(mChunkFeedbackBufferId, offsetof(ChunkFeedback, vertexCapacity), sizeof(GLuint) * 2, &mChunkFeedback.vertexCapacity);
+
+    // A moved mesh is complete, a new one is drawn once the voxelizer has filled in the index count.
+    mMeshHeap->SetDraw(mAllocation, preserve ? Math::Min((int)mChunkFeedback.indexTail, (int)indexCount) : 0, mOrigin,
+        mMeshingMode == MeshingMode::Culled ? DrawRanges::SubChunks : DrawRanges::Whole, mLevel);
 }
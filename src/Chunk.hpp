@@ -2,65 +2,218 @@
 
 #include <GL/glew.h>
 
+#include "ChunkLayout.hpp"
+#include "MeshHeap.hpp"
 #include "Shader.hpp"
-#include "Vector2.hpp"
+#include "ThreadPool.hpp"
 #include "Vector3.hpp"
+#include "VoxelStorage.hpp"
 
+#include <bitset>
+#include <vector>
+
+class CpuMesher;
+
+// Culled chunks are meshed by the feedback/voxelizer compute shaders; the other modes are meshed by
+// CpuMesher and uploaded.
+enum class MeshingMode {
+    Culled,
+    Greedy,
+    Binary
+};
+
+// Packed chunk vertex, decoded by forward.vert:
+//   PositionFace  bits 0-7 x, 8-15 y, 16-23 z  chunk-local corner position (voxel minimum corner + 0/1)
+//                 bits 24-26 face             normal index, +X -X +Y -Y +Z -Z
+//                 bits 27-28 corner           corner of the quad, 0-3
+//                 bits 29-30 occlusion        baked ambient occlusion of the corner, 0 (darkest) to 3 (open)
+//   Material      bits 0-15 layer             texture array layer of the face, from BlockRegistry
+//                 bits 16-19 block light      light of the voxel in front of the face, 0-15
+//                 bits 20-23 sky light
 struct Vertex {
-    Vector3 Position;
-    Vector2 UV;
-    Vector3 Normal;
+    GLuint PositionFace;
+    GLuint Material;
 };
 
 struct ChunkFeedback {
     GLuint vertexCount = 0;
     GLuint indexCount = 0;
+    GLuint vertexTail = 0;
+    GLuint indexTail = 0;
+    GLuint vertexCapacity = 0;
+    GLuint indexCapacity = 0;
+    GLuint overflow = 0;
+    GLuint padding = 0;
 };
 
+// The geometry of a sub-chunk is laid out as six consecutive ranges, one per face direction in the order
+// of the face index. faceQuadCounts holds the quad count of each direction, Chunk::FaceQuadCountBits each,
+// faces 0-2 in the first word and 3-5 in the second. CPU meshed chunks use the first six records for the six
+// directions of the whole chunk instead, with faceQuadCounts unused.
 struct SubChunkFeedback {
     GLuint vertexOffset = 0;
     GLuint vertexCount = 0;
     GLuint indexOffset = 0;
     GLuint indexCount = 0;
+    GLuint vertexCapacity = 0;
+    GLuint indexCapacity = 0;
+    GLuint faceQuadCounts[2] = { 0, 0 };
 };
 
 class Chunk {
 public:
-    static constexpr unsigned int ChunkSize = 80;
-    static constexpr unsigned int WorkGroupSize = 8;
-    static constexpr unsigned int SubChunkSize = ChunkSize / WorkGroupSize;
+    // The dimensions of every chunk; see Benchmark::RunChunkDimensions for how other sizes compare.
+    typedef ChunkLayout<80, 8> Layout;
+
+    static constexpr unsigned int ChunkSize = Layout::ChunkSize;
+    static constexpr unsigned int WorkGroupSize = Layout::WorkGroupSize;
+    static constexpr unsigned int SubChunkSize = Layout::SubChunkSize;
+    static constexpr unsigned int SubChunkCount = Layout::SubChunkCount;
+    static constexpr unsigned int VoxelCount = Layout::VoxelCount;
+    static constexpr unsigned int FaceQuadCountBits = Layout::FaceQuadCountBits;
+    // Level 0 is full resolution, every further level halves it, down to 8x coarser voxels.
+    static constexpr unsigned int LevelCount = 4;
 
 public:
-    Chunk();
+    // Layout::GetShaderDefines, for the shaders that work on chunks.
+    static ShaderDefines GetShaderDefines();
+
+    // Rendering needs a mesh heap; chunks that are only meshed on the CPU can do without. Coarser levels are
+    // reduced on threadPool if there is one, and right before they are drawn otherwise.
+    Chunk(const Vector3& origin = Vector3::Zero, MeshHeap* meshHeap = nullptr, ThreadPool* threadPool = nullptr);
 
     ~Chunk();
 
+    unsigned int GetVoxel(unsigned int x, unsigned int y, unsigned int z) const;
+
     void SetVoxel(unsigned int x, unsigned int y, unsigned int z, unsigned int value);
 
-    void Render(Shader* feedbackShader, Shader* voxelizerShader, Shader* forwardShader);
+    void FillRegion(unsigned int minX, unsigned int minY, unsigned int minZ, unsigned int maxX, unsigned int maxY, unsigned int maxZ, unsigned int value);
 
-    GLuint GetChunkFeedbackBufferId() const;
+    void SetVoxels(unsigned int x, unsigned int y, unsigned int z, unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ, const unsigned int* values);
+
+    template <typename Function>
+    void UpdateRegion(unsigned int minX, unsigned int minY, unsigned int minZ, unsigned int maxX, unsigned int maxY, unsigned int maxZ, Function function);
+
+    // Remeshes the chunk if needed; the mesh is drawn together with all others by MeshHeap::Draw.
+    void UpdateMesh(Shader* feedbackShader, Shader* voxelizerShader, CpuMesher* mesher);
+
+    void SetMeshingMode(MeshingMode mode);
 
-    GLuint GetSubChunkFeedbackBufferId() const;
+    MeshingMode GetMeshingMode() const;
+
+    // Meshes the chunk from a downsampled level from now on; changing the level rebuilds the whole mesh.
+    void SetLevel(unsigned int level);
+
+    unsigned int GetLevel() const;
+
+    // Writes a level into a full size voxel array. Each level merges 2x2x2 voxels of the one before: the result
+    // is solid if at least half of them are, with their most common material. The level fills the corner of
+    // ChunkSize >> level voxels per axis and the rest is left empty, so the meshers run unchanged and the mesh
+    // is scaled up by 1 << level when drawn.
+    void DecodeLevel(unsigned int level, unsigned int* voxels) const;
+
+    // Same as DecodeLevel for the light, which keeps the brightest of the 2x2x2 voxels per channel.
+    void DecodeLightLevel(unsigned int level, unsigned char* light) const;
+
+    // One byte per voxel, block light in the low and sky light in the high nibble, written by LightEngine.
+    unsigned char* GetLight();
+
+    const unsigned char* GetLight() const;
+
+    // Remeshes the voxels around [min, max) after LightEngine changed their light.
+    void InvalidateLight(unsigned int minX, unsigned int minY, unsigned int minZ, unsigned int maxX, unsigned int maxY, unsigned int maxZ);
+
+    GLuint GetChunkFeedbackBufferId() const;
 
     const ChunkFeedback& GetChunkFeedback() const;
 
     const SubChunkFeedback* GetSubChunkFeedbacks() const;
 
+    const VoxelStorage& GetStorage() const;
+
+    const Vector3& GetOrigin() const;
+
+    const std::bitset<SubChunkCount>& GetDirtySubChunks() const;
+
+    // True while the chunk waits to be remeshed or its GPU feedback has not been read back yet.
+    bool IsDirty() const;
+
 private:
+    void CreateResources();
+
+    void MarkDirty(unsigned int x, unsigned int y, unsigned int z);
+
+    void MarkDirty(unsigned int minX, unsigned int minY, unsigned int minZ, unsigned int maxX, unsigned int maxY, unsigned int maxZ);
+
+    // Reduces the voxels and light to mLevel into mLevelVoxels and mLevelLight, as a job if there is a thread pool.
+    void BuildLevel();
+
+    // Every change to the voxels or light waits for a running BuildLevel job first.
+    void WaitForLevel();
+
     void Regenerate(Shader* feedbackShader, Shader* voxelizerShader) const;
 
+    void ReadFeedback() const;
+
+    void Upload(CpuMesher* mesher) const;
+
+    void Reallocate(unsigned int vertexCount, unsigned int indexCount, bool preserve) const;
+
 private:
+    Vector3 mOrigin;
     GLuint mVoxelBufferId = 0;
-    unsigned int* mVoxels = nullptr;
+    GLuint mLightBufferId = 0;
+    VoxelStorage mStorage;
+    std::vector<unsigned char> mLight;
     GLuint mChunkFeedbackBufferId = 0;
-    GLuint mSubChunkFeedbackBufferId = 0;
+    GLuint mSubChunkListBufferId = 0;
     mutable ChunkFeedback mChunkFeedback;
     mutable SubChunkFeedback* mSubChunkFeedbacks = 0;
+    const ChunkFeedback* mMappedChunkFeedback = 0;
+    mutable GLsync mFeedbackFence = 0;
+
+    MeshHeap* mMeshHeap = nullptr;
+    mutable MeshAllocation mAllocation;
+
+    MeshingMode mMeshingMode = MeshingMode::Culled;
+    unsigned int mLevel = 0;
 
-    mutable GLuint mVertexArrayObjectId = 0;
-    mutable GLuint mVertexBufferId = 0;
-    mutable GLuint mIndexBufferId = 0;
+    // The reduced level uploaded by Regenerate, valid for mBuiltLevel once mLevelJob is done; 0 when stale.
+    ThreadPool* mThreadPool = nullptr;
+    std::vector<unsigned int> mLevelVoxels;
+    std::vector<unsigned char> mLevelLight;
+    unsigned int mBuiltLevel = 0;
+    JobCounter mLevelJob;
 
+    mutable std::bitset<SubChunkCount> mDirtySubChunks;
+    mutable bool mFullRegeneration = true;
     mutable bool mDirty = false;
 };
+
+template <typename Function>
+void Chunk::UpdateRegion(unsigned int minX, unsigned int minY, unsigned int minZ, unsigned int maxX, unsigned int maxY, unsigned int maxZ, Function function) {
+    maxX = maxX < ChunkSize ? maxX : ChunkSize;
+    maxY = maxY < ChunkSize ? maxY : ChunkSize;
+    maxZ = maxZ < ChunkSize ? maxZ : ChunkSize;
+
+    if (minX >= maxX || minY >= maxY || minZ >= maxZ) {
+        return;
+    }
+
+    WaitForLevel();
+
+    bool changed = false;
+
+    for (unsigned int z = minZ; z < maxZ; ++z) {
+        for (unsigned int y = minY; y < maxY; ++y) {
+            changed |= mStorage.Update(Layout::Index(minX, y, z), maxX - minX, [&](unsigned int offset, unsigned int value) {
+                return function(minX + offset, y, z, value);
+            });
+        }
+    }
+
+    if (changed) {
+        MarkDirty(minX, minY, minZ, maxX, maxY, maxZ);
+    }
+}
@@ -0,0 +1,16 @@
+#include "ChunkCoordinate.hpp"
+
+bool ChunkCoordinate::operator==(const ChunkCoordinate& rhs) const {
+    return X == rhs.X && Y == rhs.Y && Z == rhs.Z;
+}
+
+bool ChunkCoordinate::operator!=(const ChunkCoordinate& rhs) const {
+    return X != rhs.X || Y != rhs.Y || Z != rhs.Z;
+}
+
+size_t ChunkCoordinateHash::operator()(const ChunkCoordinate& coordinate) const {
+    size_t hash = (size_t)(unsigned int)coordinate.X * 73856093u;
+    hash ^= (size_t)(unsigned int)coordinate.Y * 19349663u;
+    hash ^= (size_t)(unsigned int)coordinate.Z * 83492791u;
+    return hash;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+
+struct ChunkCoordinate {
+    int X, Y, Z;
+
+    bool operator==(const ChunkCoordinate& rhs) const;
+
+    bool operator!=(const ChunkCoordinate& rhs) const;
+};
+
+struct ChunkCoordinateHash {
+    size_t operator()(const ChunkCoordinate& coordinate) const;
+};
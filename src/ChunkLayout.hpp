@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ShaderPreprocessor.hpp"
+
+#include <string>
+
+// Smallest shift with 1 << shift >= value.
+constexpr unsigned int ChunkLayoutShift(unsigned int value) {
+    unsigned int shift = 0;
+    while ((1u << shift) < value) {
+        ++shift;
+    }
+    return shift;
+}
+
+// Dimensions of a cubic chunk of Size voxels per axis, split into sub-chunks of GroupSize voxels per axis (the
+// compute shader work groups). Everything is known at compile time, so loops over a chunk can be unrolled and,
+// for power of two sizes, Index and Coordinates become shifts and masks instead of multiplies, divides and
+// modulos. Chunk uses one instantiation; Benchmark::RunChunkDimensions compares several.
+template <unsigned int Size, unsigned int GroupSize>
+struct ChunkLayout {
+    static constexpr unsigned int ChunkSize = Size;
+    static constexpr unsigned int WorkGroupSize = GroupSize;
+    static constexpr unsigned int SubChunkSize = ChunkSize / WorkGroupSize;
+    static constexpr unsigned int SubChunkCount = SubChunkSize * SubChunkSize * SubChunkSize;
+    static constexpr unsigned int VoxelCount = ChunkSize * ChunkSize * ChunkSize;
+    // Width of one face direction's quad count in SubChunkFeedback::faceQuadCounts.
+    static constexpr unsigned int FaceQuadCountBits = 10;
+
+    static constexpr bool PowerOfTwo = (ChunkSize & (ChunkSize - 1)) == 0;
+    // log2 of ChunkSize, only meaningful when PowerOfTwo.
+    static constexpr unsigned int Shift = ChunkLayoutShift(ChunkSize);
+    static constexpr unsigned int Mask = ChunkSize - 1;
+
+    static_assert(ChunkSize % WorkGroupSize == 0, "chunks must split into whole sub-chunks");
+    static_assert((1u << FaceQuadCountBits) > WorkGroupSize * WorkGroupSize * WorkGroupSize, "face quad counts do not fit");
+
+    static constexpr unsigned int Index(unsigned int x, unsigned int y, unsigned int z) {
+        return PowerOfTwo ? x | (y << Shift) | (z << (2 * Shift)) : x + ChunkSize * (y + ChunkSize * z);
+    }
+
+    static void Coordinates(unsigned int index, unsigned int& x, unsigned int& y, unsigned int& z) {
+        if (PowerOfTwo) {
+            x = index & Mask;
+            y = (index >> Shift) & Mask;
+            z = index >> (2 * Shift);
+        }
+        else {
+            x = index % ChunkSize;
+            y = (index / ChunkSize) % ChunkSize;
+            z = index / (ChunkSize * ChunkSize);
+        }
+    }
+
+    static constexpr unsigned int SubChunkIndex(unsigned int x, unsigned int y, unsigned int z) {
+        return x / WorkGroupSize + SubChunkSize * (y / WorkGroupSize + SubChunkSize * (z / WorkGroupSize));
+    }
+
+    // The constants as CHUNK_SIZE, WORK_GROUP_SIZE, SUB_CHUNK_SIZE, SUB_CHUNK_COUNT and FACE_QUAD_COUNT_BITS,
+    // so the shaders that work on chunks are compiled for the same layout.
+    static ShaderDefines GetShaderDefines() {
+        return {
+            { "CHUNK_SIZE", std::to_string(ChunkSize) },
+            { "WORK_GROUP_SIZE", std::to_string(WorkGroupSize) },
+            { "SUB_CHUNK_SIZE", std::to_string(SubChunkSize) },
+            { "SUB_CHUNK_COUNT", std::to_string(SubChunkCount) },
+            { "FACE_QUAD_COUNT_BITS", std::to_string(FaceQuadCountBits) }
+        };
+    }
+};
+
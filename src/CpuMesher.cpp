@@ -0,0 +1,496 @@
+#include "CpuMesher.hpp"
+#include "Math.hpp"
+
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#   include <emmintrin.h>
+#   define CPU_MESHER_SSE2
+#endif
+
+struct Face {
+    int Neighbour[3];
+    unsigned int Corners[4][3];
+};
+
+// Same face order and corner layout as voxelizer.comp. Corners are offsets from the voxel's minimum corner.
+static const Face Faces[6] = {
+    { {  1,  0,  0 }, { { 1, 1, 1 }, { 1, 0, 1 }, { 1, 0, 0 }, { 1, 1, 0 } } },
+    { { -1,  0,  0 }, { { 0, 1, 0 }, { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 } } },
+    { {  0,  1,  0 }, { { 0, 1, 0 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 } } },
+    { {  0, -1,  0 }, { { 0, 0, 1 }, { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 } } },
+    { {  0,  0,  1 }, { { 0, 1, 1 }, { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 } } },
+    { {  0,  0, -1 }, { { 1, 1, 0 }, { 1, 0, 0 }, { 0, 0, 0 }, { 0, 1, 0 } } }
+};
+
+static const int UnitExtent[3] = { 1, 1, 1 };
+
+static bool TestBit(const ColumnMask& mask, unsigned int bit) {
+    return ((mask.Words[bit >> 6] >> (bit & 63)) & 1) != 0;
+}
+
+static ColumnMask ShiftLeft(const ColumnMask& mask) {
+    ColumnMask result;
+    result.Words[0] = mask.Words[0] << 1;
+    result.Words[1] = (mask.Words[1] << 1) | (mask.Words[0] >> 63);
+    return result;
+}
+
+static ColumnMask ShiftRight(const ColumnMask& mask) {
+    ColumnMask result;
+    result.Words[0] = (mask.Words[0] >> 1) | (mask.Words[1] << 63);
+    result.Words[1] = mask.Words[1] >> 1;
+    return result;
+}
+
+static ColumnMask AndNot(const ColumnMask& lhs, const ColumnMask& rhs) {
+    ColumnMask result;
+    result.Words[0] = lhs.Words[0] & ~rhs.Words[0];
+    result.Words[1] = lhs.Words[1] & ~rhs.Words[1];
+    return result;
+}
+
+// Bit x is set where voxels[x] is solid, for up to 64 voxels. voxelizer.comp reads the voxels as signed ints,
+// which is what the SSE2 compare does as well; it turns four voxels into four bits at once.
+static unsigned long long PackSolidVoxels(const unsigned int* voxels, unsigned int count) {
+    unsigned long long bits = 0;
+    unsigned int x = 0;
+
+#ifdef CPU_MESHER_SSE2
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; x + 4 <= count; x += 4) {
+        __m128i solid = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(voxels + x)), zero);
+        bits |= (unsigned long long)_mm_movemask_ps(_mm_castsi128_ps(solid)) << x;
+    }
+#endif
+
+    for (; x < count; ++x) {
+        bits |= (unsigned long long)((int)voxels[x] > 0) << x;
+    }
+
+    return bits;
+}
+
+// Emits one quad covering extent voxels from first, in the winding and corner order of voxelizer.comp.
+static constexpr unsigned int VisibleFace = 1u << 31;
+
+// occlusion holds the ambient occlusion of the four corners, 2 bits each, see FaceOcclusion.
+static void EmitQuad(unsigned int face, const int first[3], const int extent[3], unsigned int material, unsigned int occlusion, CpuMesh& mesh) {
+    const Face& info = Faces[face];
+
+    const unsigned int vertexOffset = (unsigned int)mesh.Vertices.size();
+    mesh.Vertices.resize(vertexOffset + 4);
+
+    // Fields are written directly; this runs once per emitted face and dominates meshing time.
+    Vertex* vertices = mesh.Vertices.data() + vertexOffset;
+    unsigned int cornerOcclusion[4];
+
+    for (unsigned int corner = 0; corner < 4; ++corner) {
+        const unsigned int* offset = info.Corners[corner];
+
+        unsigned int x = (unsigned int)(first[0] + (offset[0] ? extent[0] : 0));
+        unsigned int y = (unsigned int)(first[1] + (offset[1] ? extent[1] : 0));
+        unsigned int z = (unsigned int)(first[2] + (offset[2] ? extent[2] : 0));
+
+        cornerOcclusion[corner] = (occlusion >> (2 * corner)) & 3;
+
+        vertices[corner].PositionFace = x | (y << 8) | (z << 16) | (face << 24) | (corner << 27) | (cornerOcclusion[corner] << 29);
+        vertices[corner].Material = material;
+    }
+
+    const size_t indexOffset = mesh.Indices.size();
+    mesh.Indices.resize(indexOffset + 6);
+
+    // Split along the brighter diagonal, as voxelizer.comp does.
+    const unsigned int start = cornerOcclusion[0] + cornerOcclusion[2] < cornerOcclusion[1] + cornerOcclusion[3] ? 1 : 0;
+
+    unsigned int* indices = mesh.Indices.data() + indexOffset;
+    indices[0] = vertexOffset + start;
+    indices[1] = vertexOffset + start + 1;
+    indices[2] = vertexOffset + (start + 2) % 4;
+    indices[3] = vertexOffset + (start + 2) % 4;
+    indices[4] = vertexOffset + (start + 3) % 4;
+    indices[5] = vertexOffset + start;
+}
+
+template <typename Layout>
+BasicCpuMesher<Layout>::BasicCpuMesher(ThreadPool* threadPool)
+    : mVoxels(Layout::VoxelCount), mLight(Layout::VoxelCount), mThreadPool(threadPool), mOccupancy(Layout::ChunkSize * Layout::ChunkSize),
+      mFaceMasks(6 * Layout::ChunkSize * Layout::ChunkSize) {
+}
+
+template <typename Layout>
+void BasicCpuMesher<Layout>::Mesh(const VoxelStorage& storage, const unsigned char* light, CpuMesh& mesh, MeshingMode mode) {
+    storage.Decode(0, Layout::VoxelCount, mVoxels.data());
+    std::copy(light, light + Layout::VoxelCount, mLight.begin());
+
+    MeshDecoded(mesh, mode);
+}
+
+template <typename Layout>
+void BasicCpuMesher<Layout>::SetBlockRegistry(const BlockRegistry* blockRegistry) {
+    mBlockRegistry = blockRegistry;
+}
+
+template <typename Layout>
+void BasicCpuMesher<Layout>::SetAmbientOcclusion(bool enabled) {
+    mAmbientOcclusion = enabled;
+}
+
+template <typename Layout>
+void BasicCpuMesher<Layout>::MeshDecoded(CpuMesh& mesh, MeshingMode mode) {
+    if (mode != MeshingMode::Culled) {
+        BuildFaceMasks();
+    }
+
+    const unsigned int partCount = mode == MeshingMode::Culled ? Layout::SubChunkCount : 6 * Layout::ChunkSize;
+    if (mParts.size() < partCount) {
+        mParts.resize(partCount);
+    }
+
+    ParallelFor(partCount, [this, mode](unsigned int i) {
+        if (mode == MeshingMode::Greedy) {
+            MeshSlice(i / Layout::ChunkSize, i % Layout::ChunkSize, mParts[i]);
+        }
+        else if (mode == MeshingMode::Binary) {
+            MeshColumns(i / Layout::ChunkSize, i % Layout::ChunkSize, mParts[i]);
+        }
+        else {
+            MeshSubChunk(i, mParts[i]);
+        }
+    });
+
+    Gather(partCount, mesh);
+
+    // Slices and column rows are numbered face by face, so the Greedy and Binary meshes are six consecutive
+    // ranges, one per direction.
+    for (unsigned int face = 0; face < 6; ++face) {
+        mesh.FaceIndexCounts[face] = 0;
+
+        if (mode != MeshingMode::Culled) {
+            for (unsigned int slice = 0; slice < Layout::ChunkSize; ++slice) {
+                mesh.FaceIndexCounts[face] += (unsigned int)mParts[face * Layout::ChunkSize + slice].Indices.size();
+            }
+        }
+    }
+}
+
+template <typename Layout>
+void BasicCpuMesher<Layout>::MeshSubChunk(unsigned int subChunkIndex, CpuMesh& mesh) const {
+    const unsigned int size = Layout::SubChunkSize;
+
+    const int baseX = (int)(subChunkIndex % size * Layout::WorkGroupSize);
+    const int baseY = (int)(subChunkIndex / size % size * Layout::WorkGroupSize);
+    const int baseZ = (int)(subChunkIndex / (size * size) * Layout::WorkGroupSize);
+
+    mesh.Vertices.clear();
+    mesh.Indices.clear();
+
+    // Face directions are outermost, giving the six per-direction ranges of the voxelizer.
+    for (unsigned int face = 0; face < 6; ++face) {
+        const int* neighbour = Faces[face].Neighbour;
+
+        for (int z = baseZ; z < baseZ + (int)Layout::WorkGroupSize; ++z) {
+            for (int y = baseY; y < baseY + (int)Layout::WorkGroupSize; ++y) {
+                for (int x = baseX; x < baseX + (int)Layout::WorkGroupSize; ++x) {
+                    if (!HasVoxel(x, y, z) || HasVoxel(x + neighbour[0], y + neighbour[1], z + neighbour[2])) {
+                        continue;
+                    }
+
+                    const int first[3] = { x, y, z };
+                    EmitQuad(face, first, UnitExtent, FaceMaterial(face, mVoxels[Layout::Index(x, y, z)], x, y, z),
+                        FaceOcclusion(face, x, y, z), mesh);
+                }
+            }
+        }
+    }
+}
+
+template <typename Layout>
+void BasicCpuMesher<Layout>::MeshSlice(unsigned int face, unsigned int slice, CpuMesh& mesh) const {
+    const int size = (int)Layout::ChunkSize;
+
+    // The slice is perpendicular to the face normal; a and b are the two in-plane axes.
+    const unsigned int axis = face / 2;
+    const unsigned int a = (axis + 1) % 3;
+    const unsigned int b = (axis + 2) % 3;
+
+    unsigned int mask[Layout::ChunkSize * Layout::ChunkSize];
+    unsigned char occlusion[Layout::ChunkSize * Layout::ChunkSize];
+
+    mesh.Vertices.clear();
+    mesh.Indices.clear();
+
+    const ColumnMask* faceMasks = mFaceMasks.data() + face * Layout::ChunkSize * Layout::ChunkSize;
+
+    int coord[3];
+    coord[axis] = (int)slice;
+
+    for (int j = 0; j < size; ++j) {
+        coord[b] = j;
+
+        for (int i = 0; i < size; ++i) {
+            coord[a] = i;
+
+            // Layer 0 in the dark packs to 0, so visible faces are flagged in the otherwise unused top bit.
+            unsigned int value = 0;
+            unsigned int faceOcclusion = 0;
+            if (TestBit(faceMasks[coord[1] + size * coord[2]], coord[0])) {
+                value = VisibleFace | FaceMaterial(face, mVoxels[Layout::Index(coord[0], coord[1], coord[2])], coord[0], coord[1], coord[2]);
+                faceOcclusion = FaceOcclusion(face, coord[0], coord[1], coord[2]);
+            }
+
+            mask[i + size * j] = value;
+            occlusion[i + size * j] = (unsigned char)faceOcclusion;
+        }
+    }
+
+    for (int j = 0; j < size; ++j) {
+        for (int i = 0; i < size;) {
+            const unsigned int value = mask[i + size * j];
+            if (value == 0) {
+                ++i;
+                continue;
+            }
+
+            // The value includes the light, and only faces with the same corner occlusion are merged, so that
+            // it still interpolates correctly across the merged quad.
+            const unsigned char faceOcclusion = occlusion[i + size * j];
+
+            int width = 1;
+            while (i + width < size && mask[i + width + size * j] == value && occlusion[i + width + size * j] == faceOcclusion) {
+                width++;
+            }
+
+            int height = 1;
+            for (; j + height < size; ++height) {
+                bool rowMatches = true;
+                for (int k = 0; k < width; ++k) {
+                    if (mask[i + k + size * (j + height)] != value || occlusion[i + k + size * (j + height)] != faceOcclusion) {
+                        rowMatches = false;
+                        break;
+                    }
+                }
+
+                if (!rowMatches) {
+                    break;
+                }
+            }
+
+            for (int y = j; y < j + height; ++y) {
+                for (int x = i; x < i + width; ++x) {
+                    mask[x + size * y] = 0;
+                }
+            }
+
+            int first[3];
+            int extent[3];
+            first[axis] = (int)slice;
+            first[a] = i;
+            first[b] = j;
+            extent[axis] = 1;
+            extent[a] = width;
+            extent[b] = height;
+
+            EmitQuad(face, first, extent, value & ~VisibleFace, faceOcclusion, mesh);
+
+            i += width;
+        }
+    }
+}
+
+template <typename Layout>
+void BasicCpuMesher<Layout>::BuildFaceMasks() {
+    const unsigned int size = Layout::ChunkSize;
+    const unsigned int columnCount = size * size;
+
+    // Column y + size * z holds the voxels (0..size, y, z) along x, one bit per voxel.
+    ParallelFor(size, [this, size](unsigned int z) {
+        const unsigned int* voxels = mVoxels.data() + size * size * z;
+
+        for (unsigned int y = 0; y < size; ++y) {
+            ColumnMask& column = mOccupancy[y + size * z];
+
+            column.Words[0] = PackSolidVoxels(voxels, Math::Min((int)size, 64));
+            column.Words[1] = size > 64 ? PackSolidVoxels(voxels + 64, size - 64) : 0;
+
+            voxels += size;
+        }
+    });
+
+    // Bit n of (column >> 1) is voxel n + 1, so faces towards +x are visible where the next voxel is empty,
+    // and likewise towards -x with (column << 1). Faces along y and z compare against the neighbouring
+    // column instead. Everything outside the chunk counts as empty.
+    ParallelFor(size, [this, size, columnCount](unsigned int z) {
+        const ColumnMask empty;
+
+        for (unsigned int y = 0; y < size; ++y) {
+            const unsigned int index = y + size * z;
+            const ColumnMask& column = mOccupancy[index];
+
+            mFaceMasks[0 * columnCount + index] = AndNot(column, ShiftRight(column));
+            mFaceMasks[1 * columnCount + index] = AndNot(column, ShiftLeft(column));
+            mFaceMasks[2 * columnCount + index] = AndNot(column, y + 1 < size ? mOccupancy[index + 1] : empty);
+            mFaceMasks[3 * columnCount + index] = AndNot(column, y > 0 ? mOccupancy[index - 1] : empty);
+            mFaceMasks[4 * columnCount + index] = AndNot(column, z + 1 < size ? mOccupancy[index + size] : empty);
+            mFaceMasks[5 * columnCount + index] = AndNot(column, z > 0 ? mOccupancy[index - size] : empty);
+        }
+    });
+}
+
+template <typename Layout>
+void BasicCpuMesher<Layout>::MeshColumns(unsigned int face, unsigned int z, CpuMesh& mesh) const {
+    const unsigned int size = Layout::ChunkSize;
+    const ColumnMask* faceMasks = mFaceMasks.data() + face * size * size + size * z;
+
+    mesh.Vertices.clear();
+    mesh.Indices.clear();
+
+    for (unsigned int y = 0; y < size; ++y) {
+        const unsigned int* voxels = mVoxels.data() + size * (y + size * z);
+
+        for (unsigned int word = 0; word < 2; ++word) {
+            for (unsigned long long bits = faceMasks[y].Words[word]; bits; bits &= bits - 1) {
+                const unsigned int x = word * 64 + Math::CountTrailingZeros(bits);
+                const int first[3] = { (int)x, (int)y, (int)z };
+                EmitQuad(face, first, UnitExtent, FaceMaterial(face, voxels[x], (int)x, (int)y, (int)z),
+                    FaceOcclusion(face, (int)x, (int)y, (int)z), mesh);
+            }
+        }
+    }
+}
+
+template <typename Layout>
+void BasicCpuMesher<Layout>::Gather(unsigned int partCount, CpuMesh& mesh) {
+    std::vector<unsigned int> vertexOffsets(partCount);
+    std::vector<unsigned int> indexOffsets(partCount);
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+
+    for (unsigned int i = 0; i < partCount; ++i) {
+        vertexOffsets[i] = vertexCount;
+        indexOffsets[i] = indexCount;
+        vertexCount += (unsigned int)mParts[i].Vertices.size();
+        indexCount += (unsigned int)mParts[i].Indices.size();
+    }
+
+    mesh.Vertices.resize(vertexCount);
+    mesh.Indices.resize(indexCount);
+
+    ParallelFor(partCount, [&](unsigned int i) {
+        const CpuMesh& part = mParts[i];
+
+        std::copy(part.Vertices.begin(), part.Vertices.end(), mesh.Vertices.begin() + vertexOffsets[i]);
+
+        unsigned int* indices = mesh.Indices.data() + indexOffsets[i];
+        for (size_t j = 0; j < part.Indices.size(); ++j) {
+            indices[j] = part.Indices[j] + vertexOffsets[i];
+        }
+    });
+}
+
+template <typename Layout>
+void BasicCpuMesher<Layout>::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& function) {
+    if (mThreadPool) {
+        mThreadPool->ParallelFor(count, function);
+        return;
+    }
+
+    for (unsigned int i = 0; i < count; ++i) {
+        function(i);
+    }
+}
+
+template <typename Layout>
+unsigned int BasicCpuMesher<Layout>::FaceOcclusion(unsigned int face, int x, int y, int z) const {
+    if (!mAmbientOcclusion) {
+        return 0xFF;
+    }
+
+    const Face& info = Faces[face];
+    const unsigned int a = (face / 2 + 1) % 3;
+    const unsigned int b = (face / 2 + 2) % 3;
+
+    const int front[3] = { x + info.Neighbour[0], y + info.Neighbour[1], z + info.Neighbour[2] };
+    unsigned int occlusion = 0;
+
+    for (unsigned int corner = 0; corner < 4; ++corner) {
+        int sideA[3] = { front[0], front[1], front[2] };
+        int sideB[3] = { front[0], front[1], front[2] };
+        sideA[a] += info.Corners[corner][a] ? 1 : -1;
+        sideB[b] += info.Corners[corner][b] ? 1 : -1;
+
+        int diagonal[3] = { front[0], front[1], front[2] };
+        diagonal[a] = sideA[a];
+        diagonal[b] = sideB[b];
+
+        const bool solidA = HasVoxel(sideA[0], sideA[1], sideA[2]);
+        const bool solidB = HasVoxel(sideB[0], sideB[1], sideB[2]);
+
+        unsigned int value = 0;
+        if (!solidA || !solidB) {
+            value = 3 - solidA - solidB - HasVoxel(diagonal[0], diagonal[1], diagonal[2]);
+        }
+
+        occlusion |= value << (2 * corner);
+    }
+
+    return occlusion;
+}
+
+template <typename Layout>
+unsigned int BasicCpuMesher<Layout>::FaceMaterial(unsigned int face, unsigned int value, int x, int y, int z) const {
+    const unsigned int layer = mBlockRegistry ? mBlockRegistry->GetLayer(value, face) : value & 0xFFFF;
+    return layer | (FaceLight(face, x, y, z) << 16);
+}
+
+template <typename Layout>
+unsigned int BasicCpuMesher<Layout>::FaceLight(unsigned int face, int x, int y, int z) const {
+    const int size = (int)Layout::ChunkSize;
+    const int* neighbour = Faces[face].Neighbour;
+
+    x += neighbour[0];
+    y += neighbour[1];
+    z += neighbour[2];
+
+    if (x < 0 || x >= size || y < 0 || y >= size || z < 0 || z >= size) {
+        return 0xF0;
+    }
+
+    return mLight[Layout::Index(x, y, z)];
+}
+
+template <typename Layout>
+bool BasicCpuMesher<Layout>::HasVoxel(int x, int y, int z) const {
+    const int size = (int)Layout::ChunkSize;
+
+    if (x < 0 || x >= size || y < 0 || y >= size || z < 0 || z >= size) {
+        return false;
+    }
+
+    // voxelizer.comp reads the voxels as signed ints.
+    return (int)mVoxels[Layout::Index(x, y, z)] > 0;
+}
+
+CpuMesher::CpuMesher(ThreadPool* threadPool)
+    : BasicCpuMesher<Chunk::Layout>(threadPool) {
+}
+
+void CpuMesher::Mesh(const Chunk& chunk, CpuMesh& mesh, MeshingMode mode) {
+    chunk.DecodeLevel(chunk.GetLevel(), mVoxels.data());
+    chunk.DecodeLightLevel(chunk.GetLevel(), mLight.data());
+
+    MeshDecoded(mesh, mode);
+}
+
+// The layouts Benchmark::RunChunkDimensions compares, which have to include Chunk::Layout.
+static_assert(std::is_same<Chunk::Layout, ChunkLayout<32, 8>>::value || std::is_same<Chunk::Layout, ChunkLayout<64, 8>>::value ||
+    std::is_same<Chunk::Layout, ChunkLayout<80, 8>>::value || std::is_same<Chunk::Layout, ChunkLayout<128, 8>>::value,
+    "BasicCpuMesher is not compiled for Chunk::Layout");
+
+template class BasicCpuMesher<ChunkLayout<32, 8>>;
+template class BasicCpuMesher<ChunkLayout<64, 8>>;
+template class BasicCpuMesher<ChunkLayout<80, 8>>;
+template class BasicCpuMesher<ChunkLayout<128, 8>>;
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "BlockRegistry.hpp"
+#include "Chunk.hpp"
+#include "ThreadPool.hpp"
+
+#include <vector>
+
+// Occupancy or visible faces of one column of voxels along x, one bit per voxel.
+struct ColumnMask {
+    unsigned long long Words[2] = { 0, 0 };
+};
+
+struct CpuMesh {
+    std::vector<Vertex> Vertices;
+    std::vector<unsigned int> Indices;
+    // Index count of each face direction in Greedy and Binary mode, whose meshes are grouped by direction over
+    // the whole chunk. Culled meshes are grouped by direction within each sub-chunk instead and leave these 0.
+    unsigned int FaceIndexCounts[6] = { 0, 0, 0, 0, 0, 0 };
+};
+
+// In Culled mode this is the CPU reference implementation of feedback.comp + voxelizer.comp. It emits the
+// same face-culled quads (4 vertices, 6 indices per exposed face, same winding and packed vertices) with the
+// geometry grouped per sub-chunk in sub-chunk order and by face direction within each sub-chunk, so the result
+// can be compared against the GPU output.
+// Greedy mode merges coplanar faces of the same material into maximal rectangles per chunk slice; the
+// forward shader derives UVs from the packed position, so textures repeat once per voxel on merged quads.
+// Binary mode produces the same quads as Culled, but finds visible faces a whole column at a time: every
+// column along x becomes a bitmask, x faces are (column & ~(column >> 1)) and its mirror, y and z faces
+// are (column & ~neighbour). Greedy reads its slice masks from the same face bits.
+// Everything is laid out by the given ChunkLayout; CpuMesher below meshes chunks, the other layouts are only
+// compiled for Benchmark::RunChunkDimensions.
+template <typename Layout>
+class BasicCpuMesher {
+public:
+    static_assert(Layout::ChunkSize <= 128, "ColumnMask holds at most 128 voxels per column");
+    static_assert(Layout::ChunkSize < 256, "Vertex positions are packed into 8 bits per axis");
+
+    BasicCpuMesher(ThreadPool* threadPool = nullptr);
+
+    // Meshes Layout::VoxelCount voxels and their light, one byte per voxel as LightEngine stores it.
+    void Mesh(const VoxelStorage& storage, const unsigned char* light, CpuMesh& mesh, MeshingMode mode = MeshingMode::Culled);
+
+    // Texture layers written into the vertices, like the table voxelizer.comp reads. Without a registry the
+    // voxel value is written instead.
+    void SetBlockRegistry(const BlockRegistry* blockRegistry);
+
+    // Bakes per-vertex ambient occlusion like voxelizer.comp does; disabling it leaves every corner open and
+    // is only meant for measuring its cost.
+    void SetAmbientOcclusion(bool enabled);
+
+protected:
+    // Meshes the voxels and light already in mVoxels and mLight.
+    void MeshDecoded(CpuMesh& mesh, MeshingMode mode);
+
+private:
+    void MeshSubChunk(unsigned int subChunkIndex, CpuMesh& mesh) const;
+
+    void MeshSlice(unsigned int face, unsigned int slice, CpuMesh& mesh) const;
+
+    void BuildFaceMasks();
+
+    void MeshColumns(unsigned int face, unsigned int z, CpuMesh& mesh) const;
+
+    void Gather(unsigned int partCount, CpuMesh& mesh);
+
+    void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& function);
+
+    // Ambient occlusion of the four corners of a face, 2 bits per corner in corner order.
+    unsigned int FaceOcclusion(unsigned int face, int x, int y, int z) const;
+
+    // Vertex material of a face, see Vertex in Chunk.hpp.
+    unsigned int FaceMaterial(unsigned int face, unsigned int value, int x, int y, int z) const;
+
+    // Light of the voxel in front of a face, as stored by LightEngine; open sky outside the chunk like voxelizer.comp.
+    unsigned int FaceLight(unsigned int face, int x, int y, int z) const;
+
+    bool HasVoxel(int x, int y, int z) const;
+
+protected:
+    std::vector<unsigned int> mVoxels;
+    std::vector<unsigned char> mLight;
+
+private:
+    ThreadPool* mThreadPool = nullptr;
+    const BlockRegistry* mBlockRegistry = nullptr;
+    bool mAmbientOcclusion = true;
+    std::vector<ColumnMask> mOccupancy;
+    std::vector<ColumnMask> mFaceMasks;
+    std::vector<CpuMesh> mParts;
+};
+
+class CpuMesher : public BasicCpuMesher<Chunk::Layout> {
+public:
+    CpuMesher(ThreadPool* threadPool = nullptr);
+
+    using BasicCpuMesher<Chunk::Layout>::Mesh;
+
+    // Meshes the chunk at its level, see Chunk::DecodeLevel.
+    void Mesh(const Chunk& chunk, CpuMesh& mesh, MeshingMode mode = MeshingMode::Culled);
+};
@@ -0,0 +1,94 @@
+#include "DepthPyramid.hpp"
+#include "Math.hpp"
+
+DepthPyramid::DepthPyramid() {
+}
+
+DepthPyramid::~DepthPyramid() {
+    glDeleteTextures(1, &mId);
+}
+
+void DepthPyramid::Build(Shader* shader, GLuint depthTextureId, unsigned int width, unsigned int height, const Matrix4& projection, const Matrix4& view) {
+    if (width == 0 || height == 0) {
+        mValid = false;
+        return;
+    }
+
+    // Power of two levels halve exactly, which keeps the screen to texel mapping identical on every level.
+    Resize(Math::Max((int)Math::NextPowerOfTwo(width) / 2, 1), Math::Max((int)Math::NextPowerOfTwo(height) / 2, 1));
+
+    glBindProgramPipeline(shader->GetId());
+
+    glBindTextureUnit(1, depthTextureId);
+
+    for (unsigned int level = 0; level < mLevelCount; ++level) {
+        unsigned int levelWidth = Math::Max((int)(mWidth >> level), 1);
+        unsigned int levelHeight = Math::Max((int)(mHeight >> level), 1);
+
+        glProgramUniform1i(shader->GetComputeProgramId(), 0, level == 0);
+
+        glBindImageTexture(0, mId, level > 0 ? level - 1 : 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, mId, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    mProjection = projection;
+    mView = view;
+    mValid = true;
+}
+
+void DepthPyramid::Invalidate() {
+    mValid = false;
+}
+
+bool DepthPyramid::IsValid() const {
+    return mValid;
+}
+
+GLuint DepthPyramid::GetId() const {
+    return mId;
+}
+
+unsigned int DepthPyramid::GetWidth() const {
+    return mWidth;
+}
+
+unsigned int DepthPyramid::GetHeight() const {
+    return mHeight;
+}
+
+unsigned int DepthPyramid::GetLevelCount() const {
+    return mLevelCount;
+}
+
+const Matrix4& DepthPyramid::GetProjection() const {
+    return mProjection;
+}
+
+const Matrix4& DepthPyramid::GetView() const {
+    return mView;
+}
+
+void DepthPyramid::Resize(unsigned int width, unsigned int height) {
+    if (mId && width == mWidth && height == mHeight) {
+        return;
+    }
+
+    glDeleteTextures(1, &mId);
+
+    mWidth = width;
+    mHeight = height;
+    mLevelCount = Math::CountTrailingZeros(Math::Max((int)width, (int)height)) + 1;
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &mId);
+
+    glTextureParameteri(mId, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(mId, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(mId, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(mId, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glTextureStorage2D(mId, mLevelCount, GL_R32F, mWidth, mHeight);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "Matrix4.hpp"
+#include "Shader.hpp"
+
+// Hierarchical depth buffer for occlusion culling. Every texel holds the farthest depth of the area it covers,
+// so a box whose nearest point lies behind the texels under its screen rectangle is hidden. The pyramid is
+// built from the depth buffer at the end of a frame and used to cull the next one, together with the camera
+// matrices it was rendered with.
+class DepthPyramid {
+public:
+    DepthPyramid();
+
+    ~DepthPyramid();
+
+    void Build(Shader* shader, GLuint depthTextureId, unsigned int width, unsigned int height, const Matrix4& projection, const Matrix4& view);
+
+    // Until the next Build, e.g. after the depth buffer was resized.
+    void Invalidate();
+
+    bool IsValid() const;
+
+    GLuint GetId() const;
+
+    unsigned int GetWidth() const;
+
+    unsigned int GetHeight() const;
+
+    unsigned int GetLevelCount() const;
+
+    const Matrix4& GetProjection() const;
+
+    const Matrix4& GetView() const;
+
+private:
+    void Resize(unsigned int width, unsigned int height);
+
+private:
+    GLuint mId = 0;
+    unsigned int mWidth = 0;
+    unsigned int mHeight = 0;
+    unsigned int mLevelCount = 0;
+    Matrix4 mProjection = Matrix4::Identity;
+    Matrix4 mView = Matrix4::Identity;
+    bool mValid = false;
+};
@@ -0,0 +1,524 @@
+#include "LightEngine.hpp"
+
+#include "Math.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+
+static const unsigned int Size = Chunk::ChunkSize;
+
+// Directions in the order +X -X +Y -Y +Z -Z, the opposite of d is d ^ 1.
+static const int Offsets[6][3] = {
+    {  1,  0,  0 }, { -1,  0,  0 },
+    {  0,  1,  0 }, {  0, -1,  0 },
+    {  0,  0,  1 }, {  0,  0, -1 }
+};
+
+static const unsigned int Down = 3;
+
+static unsigned int GetLevel(const unsigned char* light, unsigned int index, unsigned int channel) {
+    return (light[index] >> (channel * 4)) & 0xF;
+}
+
+static void SetLevel(unsigned char* light, unsigned int index, unsigned int channel, unsigned int level) {
+    const unsigned int shift = channel * 4;
+    light[index] = (unsigned char)((light[index] & ~(0xF << shift)) | (level << shift));
+}
+
+// Index of the voxel next to index in direction, or the index of the matching voxel in the neighbouring chunk
+// when it crosses the border, in which case crossed is set.
+static unsigned int Step(unsigned int index, unsigned int direction, bool& crossed) {
+    unsigned int coord[3] = { index % Size, index / Size % Size, index / (Size * Size) };
+    const unsigned int axis = direction / 2;
+
+    if (direction & 1) {
+        crossed = coord[axis] == 0;
+        coord[axis] = crossed ? Size - 1 : coord[axis] - 1;
+    }
+    else {
+        crossed = coord[axis] == Size - 1;
+        coord[axis] = crossed ? 0 : coord[axis] + 1;
+    }
+
+    return coord[0] + Size * (coord[1] + Size * coord[2]);
+}
+
+LightEngine::LightEngine(ThreadPool* threadPool)
+    : mThreadPool(threadPool) {
+}
+
+LightEngine::~LightEngine() {
+    for (auto& pair : mChunks) {
+        delete pair.second;
+    }
+}
+
+void LightEngine::SetEmission(unsigned int value, unsigned int level) {
+    if (value < 256) {
+        mEmission[value] = (unsigned char)Math::Min((int)level, (int)MaxLevel);
+    }
+}
+
+unsigned int LightEngine::GetEmission(unsigned int value) const {
+    return value < 256 ? mEmission[value] : 0;
+}
+
+void LightEngine::LightChunk(Chunk& chunk) const {
+    std::vector<unsigned int> voxels(Chunk::VoxelCount);
+    chunk.GetStorage().Decode(0, Chunk::VoxelCount, voxels.data());
+
+    ChunkState state;
+    state.Target = &chunk;
+    state.Voxels = voxels.data();
+
+    unsigned char* light = chunk.GetLight();
+    std::fill(light, light + Chunk::VoxelCount, (unsigned char)0);
+
+    // Sky light fills every column from the top down to the first solid voxel.
+    for (unsigned int z = 0; z < Size; ++z) {
+        for (unsigned int x = 0; x < Size; ++x) {
+            for (unsigned int y = Size; y-- > 0;) {
+                const unsigned int index = x + Size * (y + Size * z);
+                if (IsOpaque(state, index)) {
+                    break;
+                }
+
+                SetLevel(light, index, SkyLight, MaxLevel);
+            }
+        }
+    }
+
+    // Only the edges of the lit columns spread sideways, everything else is already at full level.
+    for (unsigned int index = 0; index < Chunk::VoxelCount; ++index) {
+        const unsigned int emission = GetEmission(voxels[index]);
+        if (emission > 0) {
+            SetLevel(light, index, BlockLight, emission);
+            state.Additions.push_back({ index, (unsigned char)emission, BlockLight, false });
+        }
+
+        if (GetLevel(light, index, SkyLight) != MaxLevel) {
+            continue;
+        }
+
+        for (unsigned int direction = 0; direction < 6; ++direction) {
+            bool crossed = false;
+            const unsigned int next = Step(index, direction, crossed);
+
+            if (!crossed && direction != Down && GetLevel(light, next, SkyLight) < MaxLevel - 1 && !IsOpaque(state, next)) {
+                state.Additions.push_back({ index, (unsigned char)MaxLevel, SkyLight, false });
+                break;
+            }
+        }
+    }
+
+    ProcessAdditions(state);
+}
+
+void LightEngine::AddChunk(const ChunkCoordinate& coordinate, Chunk* chunk) {
+    if (mChunks.count(coordinate)) {
+        return;
+    }
+
+    ChunkState* state = new ChunkState();
+    state->Target = chunk;
+    mChunks[coordinate] = state;
+
+    for (unsigned int direction = 0; direction < 6; ++direction) {
+        const ChunkCoordinate neighbourCoordinate = {
+            coordinate.X + Offsets[direction][0], coordinate.Y + Offsets[direction][1], coordinate.Z + Offsets[direction][2]
+        };
+
+        auto it = mChunks.find(neighbourCoordinate);
+        if (it == mChunks.end()) {
+            continue;
+        }
+
+        ChunkState* neighbour = it->second;
+        state->Neighbours[direction] = neighbour;
+        neighbour->Neighbours[direction ^ 1] = state;
+
+        SeedBorder(*state, direction);
+        SeedBorder(*neighbour, direction ^ 1);
+    }
+
+    // Both chunks were lit as if nothing was above them.
+    if (state->Neighbours[2]) {
+        CheckSkyBorder(*state, *state->Neighbours[2]);
+    }
+
+    if (state->Neighbours[Down]) {
+        CheckSkyBorder(*state->Neighbours[Down], *state);
+    }
+}
+
+void LightEngine::RemoveChunk(const ChunkCoordinate& coordinate) {
+    auto it = mChunks.find(coordinate);
+    if (it == mChunks.end()) {
+        return;
+    }
+
+    ChunkState* state = it->second;
+    for (unsigned int direction = 0; direction < 6; ++direction) {
+        if (state->Neighbours[direction]) {
+            state->Neighbours[direction]->Neighbours[direction ^ 1] = nullptr;
+        }
+    }
+
+    delete state;
+    mChunks.erase(it);
+}
+
+void LightEngine::Invalidate(const ChunkCoordinate& coordinate, unsigned int minX, unsigned int minY, unsigned int minZ,
+    unsigned int maxX, unsigned int maxY, unsigned int maxZ) {
+    auto it = mChunks.find(coordinate);
+    if (it == mChunks.end()) {
+        return;
+    }
+
+    maxX = maxX < Size ? maxX : Size;
+    maxY = maxY < Size ? maxY : Size;
+    maxZ = maxZ < Size ? maxZ : Size;
+
+    if (minX >= maxX || minY >= maxY || minZ >= maxZ) {
+        return;
+    }
+
+    it->second->Invalidated.push_back({ { minX, minY, minZ }, { maxX, maxY, maxZ } });
+}
+
+void LightEngine::Update() {
+    const double startTime = glfwGetTime();
+
+    mStatistics.Chunks = 0;
+    mStatistics.Rounds = 0;
+    mStatistics.VisitedVoxels = 0;
+
+    // Darken the edited boxes; the removal stops at brighter light around them, which is queued again. Dark
+    // voxels on the surface of a box are queued as removals of level 0, which only does the latter, so that
+    // light next to the box flows into space that was opened up.
+    for (auto& pair : mChunks) {
+        ChunkState& state = *pair.second;
+        unsigned char* light = state.Target->GetLight();
+
+        for (const Box& box : state.Invalidated) {
+            for (unsigned int z = box.Min[2]; z < box.Max[2]; ++z) {
+                for (unsigned int y = box.Min[1]; y < box.Max[1]; ++y) {
+                    for (unsigned int x = box.Min[0]; x < box.Max[0]; ++x) {
+                        const unsigned int index = x + Size * (y + Size * z);
+                        const bool surface = x == box.Min[0] || y == box.Min[1] || z == box.Min[2] ||
+                            x + 1 == box.Max[0] || y + 1 == box.Max[1] || z + 1 == box.Max[2];
+
+                        for (unsigned int channel = 0; channel < 2; ++channel) {
+                            const unsigned int level = GetLevel(light, index, channel);
+                            if (level > 0) {
+                                SetLevel(light, index, channel, 0);
+                                MarkChanged(state, index);
+                            }
+
+                            if (level > 0 || surface) {
+                                state.Removals.push_back({ index, (unsigned char)level, (unsigned char)channel, false });
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    RunRounds(true);
+
+    for (auto& pair : mChunks) {
+        ChunkState& state = *pair.second;
+
+        for (const Box& box : state.Invalidated) {
+            SeedSources(state, box);
+        }
+
+        state.Invalidated.clear();
+    }
+
+    RunRounds(false);
+
+    for (auto& pair : mChunks) {
+        ChunkState& state = *pair.second;
+
+        mStatistics.VisitedVoxels += state.VisitedVoxels;
+        state.VisitedVoxels = 0;
+
+        if (state.Changed) {
+            state.Target->InvalidateLight(state.ChangedMin[0], state.ChangedMin[1], state.ChangedMin[2],
+                state.ChangedMax[0] + 1, state.ChangedMax[1] + 1, state.ChangedMax[2] + 1);
+            state.Changed = false;
+            mStatistics.Chunks++;
+        }
+    }
+
+    mStatistics.Time = glfwGetTime() - startTime;
+}
+
+const LightStatistics& LightEngine::GetStatistics() const {
+    return mStatistics;
+}
+
+void LightEngine::RunRounds(bool removal) {
+    std::vector<ChunkState*> active;
+
+    while (true) {
+        active.clear();
+
+        // No round is running, so the incoming lists can be read without locking.
+        for (auto& pair : mChunks) {
+            ChunkState& state = *pair.second;
+            const bool pending = removal ? !state.Removals.empty() || !state.IncomingRemovals.empty() :
+                !state.Additions.empty() || !state.IncomingAdditions.empty();
+
+            if (pending) {
+                active.push_back(&state);
+            }
+        }
+
+        if (active.empty()) {
+            return;
+        }
+
+        mStatistics.Rounds++;
+
+        auto process = [&](unsigned int i) {
+            ChunkState& state = *active[i];
+
+            // Keep going while the neighbours hand over more work, which saves rounds.
+            do {
+                if (removal) {
+                    ProcessRemovals(state);
+                }
+                else {
+                    ProcessAdditions(state);
+                }
+            } while (TakeIncoming(state, removal));
+        };
+
+        if (mThreadPool) {
+            mThreadPool->ParallelFor((unsigned int)active.size(), process);
+        }
+        else {
+            for (unsigned int i = 0; i < (unsigned int)active.size(); ++i) {
+                process(i);
+            }
+        }
+    }
+}
+
+bool LightEngine::TakeIncoming(ChunkState& state, bool removal) const {
+    std::vector<Node> incoming;
+    {
+        std::lock_guard<std::mutex> lock(state.IncomingMutex);
+        incoming.swap(removal ? state.IncomingRemovals : state.IncomingAdditions);
+    }
+
+    for (const Node& node : incoming) {
+        if (removal) {
+            ReceiveRemoval(state, node.Index, node.Channel, node.Level, node.Down);
+        }
+        else {
+            ReceiveAddition(state, node.Index, node.Channel, node.Level);
+        }
+    }
+
+    return !incoming.empty();
+}
+
+void LightEngine::ProcessRemovals(ChunkState& state) const {
+    // Removals holds darkened voxels with the level they had; the queue is consumed front to back.
+    for (size_t head = 0; head < state.Removals.size(); ++head) {
+        const Node node = state.Removals[head];
+        state.VisitedVoxels++;
+
+        for (unsigned int direction = 0; direction < 6; ++direction) {
+            bool crossed = false;
+            const unsigned int next = Step(node.Index, direction, crossed);
+
+            if (crossed) {
+                Send(state, direction, next, node.Channel, node.Level, true);
+            }
+            else {
+                ReceiveRemoval(state, next, node.Channel, node.Level, direction == Down);
+            }
+        }
+    }
+
+    state.Removals.clear();
+}
+
+void LightEngine::ProcessAdditions(ChunkState& state) const {
+    const unsigned char* light = state.Target->GetLight();
+
+    for (size_t head = 0; head < state.Additions.size(); ++head) {
+        const Node node = state.Additions[head];
+
+        // The voxel was darkened or brightened again after it was queued.
+        if (GetLevel(light, node.Index, node.Channel) != node.Level) {
+            continue;
+        }
+
+        state.VisitedVoxels++;
+
+        for (unsigned int direction = 0; direction < 6; ++direction) {
+            const bool fullSky = node.Channel == SkyLight && direction == Down && node.Level == MaxLevel;
+            const unsigned int level = fullSky ? MaxLevel : node.Level - 1u;
+
+            if (level == 0) {
+                continue;
+            }
+
+            bool crossed = false;
+            const unsigned int next = Step(node.Index, direction, crossed);
+
+            if (crossed) {
+                Send(state, direction, next, node.Channel, level, false);
+            }
+            else {
+                ReceiveAddition(state, next, node.Channel, level);
+            }
+        }
+    }
+
+    state.Additions.clear();
+}
+
+void LightEngine::ReceiveRemoval(ChunkState& state, unsigned int index, unsigned int channel, unsigned int oldLevel, bool down) const {
+    unsigned char* light = state.Target->GetLight();
+    const unsigned int level = GetLevel(light, index, channel);
+
+    if (level == 0) {
+        return;
+    }
+
+    // Full sky light below full sky light came from above, anything else at least as bright has another source.
+    if (level >= oldLevel && !(channel == SkyLight && down && level == MaxLevel && oldLevel == MaxLevel)) {
+        state.Additions.push_back({ index, (unsigned char)level, (unsigned char)channel, false });
+        return;
+    }
+
+    SetLevel(light, index, channel, 0);
+    MarkChanged(state, index);
+    state.Removals.push_back({ index, (unsigned char)level, (unsigned char)channel, false });
+
+    if (channel == BlockLight) {
+        const unsigned int emission = GetEmission(state.Target->GetStorage().GetVoxel(index));
+        if (emission > 0) {
+            SetLevel(light, index, channel, emission);
+            state.Additions.push_back({ index, (unsigned char)emission, (unsigned char)channel, false });
+        }
+    }
+}
+
+void LightEngine::ReceiveAddition(ChunkState& state, unsigned int index, unsigned int channel, unsigned int level) const {
+    unsigned char* light = state.Target->GetLight();
+
+    if (GetLevel(light, index, channel) >= level || IsOpaque(state, index)) {
+        return;
+    }
+
+    SetLevel(light, index, channel, level);
+    MarkChanged(state, index);
+    state.Additions.push_back({ index, (unsigned char)level, (unsigned char)channel, false });
+}
+
+void LightEngine::SeedSources(ChunkState& state, const Box& box) const {
+    unsigned char* light = state.Target->GetLight();
+    const bool openSky = !state.Neighbours[2];
+
+    for (unsigned int z = box.Min[2]; z < box.Max[2]; ++z) {
+        for (unsigned int y = box.Min[1]; y < box.Max[1]; ++y) {
+            for (unsigned int x = box.Min[0]; x < box.Max[0]; ++x) {
+                const unsigned int index = x + Size * (y + Size * z);
+
+                const unsigned int emission = GetEmission(state.Target->GetStorage().GetVoxel(index));
+                if (emission > GetLevel(light, index, BlockLight)) {
+                    SetLevel(light, index, BlockLight, emission);
+                    MarkChanged(state, index);
+                    state.Additions.push_back({ index, (unsigned char)emission, BlockLight, false });
+                }
+
+                // The sky above the top of a chunk column is not stored anywhere, so it is seeded here.
+                if (openSky && y == Size - 1 && !IsOpaque(state, index)) {
+                    SetLevel(light, index, SkyLight, MaxLevel);
+                    MarkChanged(state, index);
+                    state.Additions.push_back({ index, (unsigned char)MaxLevel, SkyLight, false });
+                }
+            }
+        }
+    }
+}
+
+void LightEngine::SeedBorder(ChunkState& state, unsigned int direction) const {
+    const unsigned char* light = state.Target->GetLight();
+
+    const unsigned int axis = direction / 2;
+    const unsigned int a = (axis + 1) % 3;
+    const unsigned int b = (axis + 2) % 3;
+
+    unsigned int coord[3];
+    coord[axis] = direction & 1 ? 0 : Size - 1;
+
+    for (coord[b] = 0; coord[b] < Size; ++coord[b]) {
+        for (coord[a] = 0; coord[a] < Size; ++coord[a]) {
+            const unsigned int index = coord[0] + Size * (coord[1] + Size * coord[2]);
+
+            for (unsigned int channel = 0; channel < 2; ++channel) {
+                const unsigned int level = GetLevel(light, index, channel);
+                if (level > 1) {
+                    state.Additions.push_back({ index, (unsigned char)level, (unsigned char)channel, false });
+                }
+            }
+        }
+    }
+}
+
+void LightEngine::CheckSkyBorder(ChunkState& lower, const ChunkState& upper) const {
+    unsigned char* lowerLight = lower.Target->GetLight();
+    const unsigned char* upperLight = upper.Target->GetLight();
+
+    for (unsigned int z = 0; z < Size; ++z) {
+        for (unsigned int x = 0; x < Size; ++x) {
+            const unsigned int top = x + Size * ((Size - 1) + Size * z);
+            const unsigned int bottom = x + Size * Size * z;
+
+            if (GetLevel(lowerLight, top, SkyLight) == MaxLevel && GetLevel(upperLight, bottom, SkyLight) < MaxLevel) {
+                SetLevel(lowerLight, top, SkyLight, 0);
+                MarkChanged(lower, top);
+                lower.Removals.push_back({ top, (unsigned char)MaxLevel, SkyLight, false });
+            }
+        }
+    }
+}
+
+void LightEngine::Send(ChunkState& state, unsigned int direction, unsigned int index, unsigned int channel, unsigned int level, bool removal) const {
+    ChunkState* neighbour = state.Neighbours[direction];
+    if (!neighbour) {
+        return;
+    }
+
+    const Node node = { index, (unsigned char)level, (unsigned char)channel, direction == Down };
+
+    std::lock_guard<std::mutex> lock(neighbour->IncomingMutex);
+    (removal ? neighbour->IncomingRemovals : neighbour->IncomingAdditions).push_back(node);
+}
+
+void LightEngine::MarkChanged(ChunkState& state, unsigned int index) const {
+    const unsigned int coord[3] = { index % Size, index / Size % Size, index / (Size * Size) };
+
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        state.ChangedMin[axis] = state.Changed ? Math::Min((int)state.ChangedMin[axis], (int)coord[axis]) : coord[axis];
+        state.ChangedMax[axis] = state.Changed ? Math::Max((int)state.ChangedMax[axis], (int)coord[axis]) : coord[axis];
+    }
+
+    state.Changed = true;
+}
+
+bool LightEngine::IsOpaque(const ChunkState& state, unsigned int index) const {
+    // Same test as the meshers, which read the voxels as signed ints.
+    const unsigned int value = state.Voxels ? state.Voxels[index] : state.Target->GetStorage().GetVoxel(index);
+    return (int)value > 0;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Chunk.hpp"
+#include "ChunkCoordinate.hpp"
+#include "ThreadPool.hpp"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct LightStatistics {
+    unsigned int Chunks = 0;
+    unsigned int Rounds = 0;
+    unsigned int VisitedVoxels = 0;
+    double Time = 0.0;
+};
+
+// Block light and sky light, 4 bits each, flood filled over the voxels of all loaded chunks and stored in the
+// light array of every chunk (block light in the low, sky light in the high nibble). Light drops by one per
+// voxel and does not enter solid voxels; sky light falls straight down from the top of a chunk column without
+// dropping. Edits are relit incrementally: the edited box is darkened with a removal flood fill, which stops
+// at brighter light and queues it again, and the freed space is refilled from there and from the sources
+// inside the box. Every chunk is processed on its own, in parallel, and light crossing a border is handed to
+// the neighbour for the next round, until no chunk has work left.
+class LightEngine {
+public:
+    static constexpr unsigned int MaxLevel = 15;
+    static constexpr unsigned int BlockLight = 0;
+    static constexpr unsigned int SkyLight = 1;
+
+public:
+    LightEngine(ThreadPool* threadPool = nullptr);
+
+    ~LightEngine();
+
+    // Light emitted by voxels of the given value; nothing emits by default. Only values below 256 can emit.
+    void SetEmission(unsigned int value, unsigned int level);
+
+    unsigned int GetEmission(unsigned int value) const;
+
+    // Lights a chunk on its own, with open sky above and no neighbours. Touches nothing but the chunk, so
+    // generator threads can call it before the chunk is added.
+    void LightChunk(Chunk& chunk) const;
+
+    // Links a lit chunk to its loaded neighbours; light is exchanged across the shared borders by Update.
+    void AddChunk(const ChunkCoordinate& coordinate, Chunk* chunk);
+
+    // Light that came from the removed chunk stays in its neighbours until they are edited.
+    void RemoveChunk(const ChunkCoordinate& coordinate);
+
+    // Relights the voxels in [min, max) of a chunk after they were edited, in chunk coordinates.
+    void Invalidate(const ChunkCoordinate& coordinate, unsigned int minX, unsigned int minY, unsigned int minZ,
+        unsigned int maxX, unsigned int maxY, unsigned int maxZ);
+
+    // Propagates all pending changes and marks the changed parts of the chunk meshes dirty.
+    void Update();
+
+    const LightStatistics& GetStatistics() const;
+
+private:
+    struct Node {
+        unsigned int Index;
+        unsigned char Level;
+        unsigned char Channel;
+        // Set on sky light handed over from the chunk above, which does not drop at full level.
+        bool Down;
+    };
+
+    struct Box {
+        unsigned int Min[3];
+        unsigned int Max[3];
+    };
+
+    struct ChunkState {
+        Chunk* Target = nullptr;
+        // Decoded voxels while a chunk is lit on its own, read from the chunk's storage otherwise.
+        const unsigned int* Voxels = nullptr;
+        // +X -X +Y -Y +Z -Z, null where no chunk is loaded.
+        ChunkState* Neighbours[6] = {};
+
+        std::vector<Box> Invalidated;
+        std::vector<Node> Removals;
+        std::vector<Node> Additions;
+
+        // Filled by the neighbours while a round runs, picked up before the next one.
+        std::mutex IncomingMutex;
+        std::vector<Node> IncomingRemovals;
+        std::vector<Node> IncomingAdditions;
+
+        unsigned int VisitedVoxels = 0;
+        bool Changed = false;
+        unsigned int ChangedMin[3] = {};
+        unsigned int ChangedMax[3] = {};
+    };
+
+private:
+    void RunRounds(bool removal);
+
+    // Applies what the neighbours handed over, returns false if there was nothing.
+    bool TakeIncoming(ChunkState& state, bool removal) const;
+
+    void ProcessRemovals(ChunkState& state) const;
+
+    void ProcessAdditions(ChunkState& state) const;
+
+    void ReceiveRemoval(ChunkState& state, unsigned int index, unsigned int channel, unsigned int oldLevel, bool down) const;
+
+    void ReceiveAddition(ChunkState& state, unsigned int index, unsigned int channel, unsigned int level) const;
+
+    void SeedSources(ChunkState& state, const Box& box) const;
+
+    void SeedBorder(ChunkState& state, unsigned int direction) const;
+
+    void CheckSkyBorder(ChunkState& lower, const ChunkState& upper) const;
+
+    void Send(ChunkState& state, unsigned int direction, unsigned int index, unsigned int channel, unsigned int level, bool removal) const;
+
+    void MarkChanged(ChunkState& state, unsigned int index) const;
+
+    bool IsOpaque(const ChunkState& state, unsigned int index) const;
+
+private:
+    ThreadPool* mThreadPool = nullptr;
+    unsigned char mEmission[256] = {};
+    std::unordered_map<ChunkCoordinate, ChunkState*, ChunkCoordinateHash> mChunks;
+    LightStatistics mStatistics;
+};
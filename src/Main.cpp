@@ -1,5 +1,14 @@
 #include "Main.hpp"
 
+#include <string.h>
+
 int main(int argc, char* argv[]) {
-    Application().Run();
+    if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+        Benchmark().Run();
+        return 0;
+    }
+
+    bool compareMeshes = argc > 1 && strcmp(argv[1], "--compare-meshes") == 0;
+
+    Application(compareMeshes).Run();
 }
@@ -1,3 +1,4 @@
 #pragma once 
 
 #include "Application.hpp"
+#include "Benchmark.hpp"
@@ -2,6 +2,10 @@
 
 #include <math.h>
 
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
 float Math::RadiansToDegrees(float radians) {
     return radians * 180.0f / PI;
 }
@@ -110,3 +114,13 @@ float Math::Log(float v) {
 unsigned int Math::Align(unsigned int size, unsigned int align) {
     return (size + align - 1) & ~(align - 1);
 }
+
+unsigned int Math::CountTrailingZeros(unsigned long long value) {
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward64(&index, value);
+    return (unsigned int)index;
+#else
+    return (unsigned int)__builtin_ctzll(value);
+#endif
+}
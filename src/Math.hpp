@@ -50,4 +50,6 @@ struct Math {
     static float Log(float v);
 
     static unsigned int Align(unsigned int size, unsigned int align);
+
+    static unsigned int CountTrailingZeros(unsigned long long value);
 };
@@ -0,0 +1,347 @@
+#include "MeshHeap.hpp"
+#include "Chunk.hpp"
+#include "Math.hpp"
+
+bool MeshAllocation::IsValid() const {
+    return Page != InvalidPage;
+}
+
+MeshHeap::MeshHeap() {
+}
+
+MeshHeap::~MeshHeap() {
+    for (Page& page : mPages) {
+        DestroyPage(page);
+    }
+
+    for (CullingStatisticsFrame& frame : mCullingFrames) {
+        if (frame.Fence) {
+            glDeleteSync(frame.Fence);
+        }
+
+        glDeleteBuffers(1, &frame.BufferId);
+    }
+}
+
+bool MeshHeap::Allocate(unsigned int vertexCount, unsigned int indexCount, MeshAllocation& allocation) {
+    for (unsigned int i = 0; i <= (unsigned int)mPages.size(); ++i) {
+        unsigned int pageIndex = i;
+        if (i == mPages.size()) {
+            pageIndex = CreatePage(vertexCount, indexCount);
+        }
+
+        Page& page = mPages[pageIndex];
+        if (!page.VertexBufferId) {
+            continue;
+        }
+
+        unsigned int vertexOffset = page.Vertices.Allocate(vertexCount);
+        if (vertexOffset == RangeAllocator::InvalidOffset) {
+            continue;
+        }
+
+        unsigned int indexOffset = page.Indices.Allocate(indexCount);
+        if (indexOffset == RangeAllocator::InvalidOffset) {
+            page.Vertices.Free(vertexOffset, vertexCount);
+            continue;
+        }
+
+        unsigned int drawSlot = page.Draws.Allocate(1);
+        if (drawSlot == RangeAllocator::InvalidOffset) {
+            page.Indices.Free(indexOffset, indexCount);
+            page.Vertices.Free(vertexOffset, vertexCount);
+            continue;
+        }
+
+        page.DrawCount = Math::Max((int)page.DrawCount, (int)drawSlot + 1);
+        page.Allocations++;
+
+        allocation.Page = pageIndex;
+        allocation.VertexOffset = vertexOffset;
+        allocation.VertexCount = vertexCount;
+        allocation.IndexOffset = indexOffset;
+        allocation.IndexCount = indexCount;
+        allocation.DrawSlot = drawSlot;
+        return true;
+    }
+
+    return false;
+}
+
+void MeshHeap::Free(MeshAllocation& allocation) {
+    if (!allocation.IsValid()) {
+        return;
+    }
+
+    Page& page = mPages[allocation.Page];
+    page.Vertices.Free(allocation.VertexOffset, allocation.VertexCount);
+    page.Indices.Free(allocation.IndexOffset, allocation.IndexCount);
+    page.Draws.Free(allocation.DrawSlot, 1);
+
+    // The first page stays around so that streaming chunks in and out does not keep recreating it.
+    if (--page.Allocations == 0 && allocation.Page > 0) {
+        DestroyPage(page);
+    }
+    else {
+        const DrawCommand command;
+        glNamedBufferSubData(page.DrawCommandBufferId, sizeof(DrawCommand) * allocation.DrawSlot, sizeof(DrawCommand), &command);
+
+        const DrawData data;
+        glNamedBufferSubData(page.DrawDataBufferId, sizeof(DrawData) * allocation.DrawSlot, sizeof(DrawData), &data);
+
+        if (page.Allocations == 0) {
+            page.DrawCount = 0;
+        }
+    }
+
+    allocation = MeshAllocation();
+}
+
+void MeshHeap::SetDraw(const MeshAllocation& allocation, unsigned int indexCount, const Vector3& origin, DrawRanges ranges, unsigned int level) {
+    const Page& page = mPages[allocation.Page];
+
+    DrawCommand command;
+    command.indexCount = indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = allocation.IndexOffset;
+    command.vertexOffset = (GLint)allocation.VertexOffset;
+    command.firstInstance = allocation.DrawSlot;
+    glNamedBufferSubData(page.DrawCommandBufferId, sizeof(DrawCommand) * allocation.DrawSlot, sizeof(DrawCommand), &command);
+
+    DrawData data;
+    data.Origin = origin;
+    data.Ranges = ranges;
+    data.IndexCapacity = allocation.IndexCount;
+    data.Level = level;
+    glNamedBufferSubData(page.DrawDataBufferId, sizeof(DrawData) * allocation.DrawSlot, sizeof(DrawData), &data);
+}
+
+void MeshHeap::Draw(Shader* cullingShader, Shader* forwardShader, const DepthPyramid* depthPyramid) {
+    if (!mCullingFrames[0].BufferId) {
+        for (CullingStatisticsFrame& frame : mCullingFrames) {
+            glCreateBuffers(1, &frame.BufferId);
+            glNamedBufferStorage(frame.BufferId, sizeof(CullingStatistics), 0, GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+
+            frame.MappedStatistics = (const CullingStatistics*)glMapNamedBufferRange(frame.BufferId, 0, sizeof(CullingStatistics),
+                GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+        }
+    }
+
+    // Oldest first, so the newest finished frame is the one that remains. A frame is not written again until
+    // it comes round in the ring, so its counters can be read without a stall once its fence has signaled.
+    for (unsigned int i = 0; i < CullingStatisticsFrameCount; ++i) {
+        CullingStatisticsFrame& frame = mCullingFrames[(mCullingFrame + i) % CullingStatisticsFrameCount];
+        if (!frame.Fence) {
+            continue;
+        }
+
+        GLint status = GL_UNSIGNALED;
+        glGetSynciv(frame.Fence, GL_SYNC_STATUS, 1, NULL, &status);
+
+        if (status == GL_SIGNALED) {
+            mCullingStatistics = *frame.MappedStatistics;
+
+            glDeleteSync(frame.Fence);
+            frame.Fence = 0;
+        }
+    }
+
+    // With the GPU more than the whole ring behind, this frame's previous counters are dropped unread.
+    CullingStatisticsFrame& frame = mCullingFrames[mCullingFrame];
+    if (frame.Fence) {
+        glDeleteSync(frame.Fence);
+        frame.Fence = 0;
+    }
+
+    glClearNamedBufferData(frame.BufferId, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, frame.BufferId);
+
+    glBindProgramPipeline(cullingShader->GetId());
+
+    const bool occlusionCulling = depthPyramid && depthPyramid->IsValid();
+    glProgramUniform1i(cullingShader->GetComputeProgramId(), 1, occlusionCulling);
+
+    if (occlusionCulling) {
+        glProgramUniformMatrix4fv(cullingShader->GetComputeProgramId(), 2, 1, GL_FALSE, depthPyramid->GetProjection().Values);
+        glProgramUniformMatrix4fv(cullingShader->GetComputeProgramId(), 6, 1, GL_FALSE, depthPyramid->GetView().Values);
+        glBindTextureUnit(1, depthPyramid->GetId());
+    }
+
+    for (const Page& page : mPages) {
+        if (page.DrawCount == 0) {
+            continue;
+        }
+
+        glClearNamedBufferData(page.VisibleDrawCountBufferId, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, page.SubChunkFeedbackBufferId);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, page.DrawCommandBufferId);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, page.DrawDataBufferId);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, page.VisibleDrawCommandBufferId);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, page.VisibleDrawCountBufferId);
+
+        glProgramUniform1ui(cullingShader->GetComputeProgramId(), 0, page.DrawCount);
+
+        glDispatchCompute((page.DrawCount * Chunk::SubChunkCount + CullingWorkGroupSize - 1) / CullingWorkGroupSize, 1, 1);
+    }
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+    glBindProgramPipeline(forwardShader->GetId());
+
+    for (const Page& page : mPages) {
+        if (page.DrawCount == 0) {
+            continue;
+        }
+
+        glBindVertexArray(page.VertexArrayId);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, page.VisibleDrawCommandBufferId);
+        glBindBuffer(GL_PARAMETER_BUFFER, page.VisibleDrawCountBufferId);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, page.DrawDataBufferId);
+
+        glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, 0, page.DrawCount * Chunk::SubChunkCount * SubChunkDrawCount, 0);
+    }
+
+    frame.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mCullingFrame = (mCullingFrame + 1) % CullingStatisticsFrameCount;
+}
+
+GLuint MeshHeap::GetVertexBufferId(unsigned int page) const {
+    return mPages[page].VertexBufferId;
+}
+
+GLuint MeshHeap::GetIndexBufferId(unsigned int page) const {
+    return mPages[page].IndexBufferId;
+}
+
+GLuint MeshHeap::GetVertexArrayId(unsigned int page) const {
+    return mPages[page].VertexArrayId;
+}
+
+GLuint MeshHeap::GetDrawCommandBufferId(unsigned int page) const {
+    return mPages[page].DrawCommandBufferId;
+}
+
+GLuint MeshHeap::GetSubChunkFeedbackBufferId(unsigned int page) const {
+    return mPages[page].SubChunkFeedbackBufferId;
+}
+
+const CullingStatistics& MeshHeap::GetCullingStatistics() const {
+    return mCullingStatistics;
+}
+
+MeshHeapStatistics MeshHeap::GetStatistics() const {
+    MeshHeapStatistics statistics;
+    size_t freeBytes = 0;
+    size_t largestFreeBytes = 0;
+
+    for (const Page& page : mPages) {
+        if (!page.VertexBufferId) {
+            continue;
+        }
+
+        statistics.Pages++;
+        statistics.Allocations += page.Allocations;
+        statistics.ReservedBytes += (size_t)page.Vertices.GetSize() * sizeof(Vertex) + (size_t)page.Indices.GetSize() * sizeof(GLuint);
+        statistics.UsedBytes += (size_t)page.Vertices.GetUsedSize() * sizeof(Vertex) + (size_t)page.Indices.GetUsedSize() * sizeof(GLuint);
+        statistics.FreeRanges += page.Vertices.GetFreeRangeCount() + page.Indices.GetFreeRangeCount();
+
+        freeBytes += (size_t)(page.Vertices.GetSize() - page.Vertices.GetUsedSize()) * sizeof(Vertex);
+        freeBytes += (size_t)(page.Indices.GetSize() - page.Indices.GetUsedSize()) * sizeof(GLuint);
+        largestFreeBytes += (size_t)page.Vertices.GetLargestFreeRange() * sizeof(Vertex);
+        largestFreeBytes += (size_t)page.Indices.GetLargestFreeRange() * sizeof(GLuint);
+    }
+
+    if (freeBytes > 0) {
+        statistics.Fragmentation = 1.0f - (float)largestFreeBytes / (float)freeBytes;
+    }
+
+    return statistics;
+}
+
+unsigned int MeshHeap::CreatePage(unsigned int vertexCount, unsigned int indexCount) {
+    if (!mVertexAlignment) {
+        // Chunks bind their ranges as shader storage, so every range has to start on the binding alignment.
+        GLint alignment = 0;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment = Math::Max(alignment, (int)sizeof(Vertex));
+
+        mVertexAlignment = alignment / sizeof(Vertex);
+        mIndexAlignment = alignment / sizeof(GLuint);
+    }
+
+    unsigned int pageIndex = 0;
+    while (pageIndex < mPages.size() && mPages[pageIndex].VertexBufferId) {
+        pageIndex++;
+    }
+
+    if (pageIndex == mPages.size()) {
+        mPages.emplace_back();
+    }
+
+    Page& page = mPages[pageIndex];
+    vertexCount = Math::Align(Math::Max((int)vertexCount, (int)PageVertexCount), mVertexAlignment);
+    indexCount = Math::Align(Math::Max((int)indexCount, (int)PageIndexCount), mIndexAlignment);
+
+    glCreateBuffers(1, &page.VertexBufferId);
+    glNamedBufferStorage(page.VertexBufferId, sizeof(Vertex) * vertexCount, 0, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateBuffers(1, &page.IndexBufferId);
+    glNamedBufferStorage(page.IndexBufferId, sizeof(GLuint) * indexCount, 0, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateBuffers(1, &page.DrawCommandBufferId);
+    glNamedBufferStorage(page.DrawCommandBufferId, sizeof(DrawCommand) * PageDrawCount, 0, GL_DYNAMIC_STORAGE_BIT);
+    glClearNamedBufferData(page.DrawCommandBufferId, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+    glCreateBuffers(1, &page.DrawDataBufferId);
+    glNamedBufferStorage(page.DrawDataBufferId, sizeof(DrawData) * PageDrawCount, 0, GL_DYNAMIC_STORAGE_BIT);
+    glClearNamedBufferData(page.DrawDataBufferId, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+    glCreateBuffers(1, &page.SubChunkFeedbackBufferId);
+    glNamedBufferStorage(page.SubChunkFeedbackBufferId, sizeof(SubChunkFeedback) * Chunk::SubChunkCount * PageDrawCount, 0, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateBuffers(1, &page.VisibleDrawCommandBufferId);
+    glNamedBufferStorage(page.VisibleDrawCommandBufferId, sizeof(DrawCommand) * Chunk::SubChunkCount * SubChunkDrawCount * PageDrawCount, 0, 0);
+
+    glCreateBuffers(1, &page.VisibleDrawCountBufferId);
+    glNamedBufferStorage(page.VisibleDrawCountBufferId, sizeof(GLuint), 0, 0);
+
+    glCreateVertexArrays(1, &page.VertexArrayId);
+
+    glEnableVertexArrayAttrib(page.VertexArrayId, 0);
+    glEnableVertexArrayAttrib(page.VertexArrayId, 1);
+
+    glVertexArrayAttribIFormat(page.VertexArrayId, 0, 1, GL_UNSIGNED_INT, offsetof(Vertex, PositionFace));
+    glVertexArrayAttribIFormat(page.VertexArrayId, 1, 1, GL_UNSIGNED_INT, offsetof(Vertex, Material));
+
+    glVertexArrayAttribBinding(page.VertexArrayId, 0, 0);
+    glVertexArrayAttribBinding(page.VertexArrayId, 1, 0);
+
+    glVertexArrayVertexBuffer(page.VertexArrayId, 0, page.VertexBufferId, 0, sizeof(Vertex));
+    glVertexArrayElementBuffer(page.VertexArrayId, page.IndexBufferId);
+
+    page.Vertices = RangeAllocator(vertexCount, mVertexAlignment);
+    page.Indices = RangeAllocator(indexCount, mIndexAlignment);
+    page.Draws = RangeAllocator(PageDrawCount);
+    page.DrawCount = 0;
+    page.Allocations = 0;
+
+    return pageIndex;
+}
+
+void MeshHeap::DestroyPage(Page& page) {
+    if (!page.VertexBufferId) {
+        return;
+    }
+
+    glDeleteVertexArrays(1, &page.VertexArrayId);
+    glDeleteBuffers(1, &page.VisibleDrawCountBufferId);
+    glDeleteBuffers(1, &page.VisibleDrawCommandBufferId);
+    glDeleteBuffers(1, &page.SubChunkFeedbackBufferId);
+    glDeleteBuffers(1, &page.DrawDataBufferId);
+    glDeleteBuffers(1, &page.DrawCommandBufferId);
+    glDeleteBuffers(1, &page.IndexBufferId);
+    glDeleteBuffers(1, &page.VertexBufferId);
+
+    page = Page();
+}
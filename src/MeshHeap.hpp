@@ -0,0 +1,168 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "DepthPyramid.hpp"
+#include "RangeAllocator.hpp"
+#include "Shader.hpp"
+#include "Vector3.hpp"
+
+#include <stddef.h>
+
+#include <vector>
+
+// Matches DrawElementsIndirectCommand. Each allocation owns one command in its page: firstIndex, vertexOffset
+// and firstInstance (the draw slot, which forward.vert uses to find the chunk origin) are written by the CPU,
+// the index count by voxelizer.comp for GPU meshed chunks or by the CPU otherwise.
+struct DrawCommand {
+    GLuint indexCount = 0;
+    GLuint instanceCount = 0;
+    GLuint firstIndex = 0;
+    GLint vertexOffset = 0;
+    GLuint firstInstance = 0;
+};
+
+// How culling.comp finds the geometry of a draw slot.
+enum class DrawRanges : GLuint {
+    None,
+    // Six direction ranges per sub-chunk, from the SubChunkFeedback records of the slot (GPU meshed chunks).
+    SubChunks,
+    // Six direction ranges covering the whole chunk, from the first six records of the slot (CPU meshed chunks).
+    Whole
+};
+
+struct DrawData {
+    Vector3 Origin = Vector3::Zero;
+    DrawRanges Ranges = DrawRanges::None;
+    GLuint IndexCapacity = 0;
+    // Level of detail the mesh was built from; forward.vert scales positions by 1 << Level.
+    GLuint Level = 0;
+    GLuint Padding[2] = { 0, 0 };
+};
+
+// Vertex and index ranges of one chunk mesh plus its draw slot. Offsets and counts are in elements of the page
+// buffers; the counts are the reserved capacity, not the size of the mesh currently stored.
+struct MeshAllocation {
+    static constexpr unsigned int InvalidPage = 0xFFFFFFFF;
+
+    unsigned int Page = InvalidPage;
+    unsigned int VertexOffset = 0;
+    unsigned int VertexCount = 0;
+    unsigned int IndexOffset = 0;
+    unsigned int IndexCount = 0;
+    unsigned int DrawSlot = 0;
+
+    bool IsValid() const;
+};
+
+struct MeshHeapStatistics {
+    unsigned int Pages = 0;
+    unsigned int Allocations = 0;
+    size_t ReservedBytes = 0;
+    size_t UsedBytes = 0;
+    unsigned int FreeRanges = 0;
+    // 0 when every page's free space is one contiguous range, towards 1 as it splinters into small holes.
+    float Fragmentation = 0.0f;
+};
+
+// Triangle and vertex counts of one frame, written by culling.comp. Direction culled triangles belong to face
+// directions pointing away from the camera in otherwise visible ranges; submitted vertices are the quad
+// vertices of everything drawn.
+struct CullingStatistics {
+    GLuint DrawnTriangles = 0;
+    GLuint FrustumCulledTriangles = 0;
+    GLuint OcclusionCulledTriangles = 0;
+    GLuint DirectionCulledTriangles = 0;
+    GLuint SubmittedVertices = 0;
+    GLuint Padding[3] = { 0, 0, 0 };
+};
+
+// Shared storage for chunk meshes: pages of one immutable vertex buffer and one index buffer each, with a
+// vertex array per page, sub-allocated by RangeAllocator. A new page is created when no page has room,
+// sized up for meshes larger than the default, and released again once its last allocation is freed.
+// Every page also keeps an array of draw commands and sub-chunk feedback records, one entry per allocation.
+// Draw runs culling.comp over all slots of a page, which appends commands for every sub-chunk (or whole
+// CPU meshed chunk) inside the view frustum and not hidden behind the depth pyramid, and submits them with a
+// single glMultiDrawElementsIndirectCount. Only the face directions that can face the camera are drawn;
+// opposite directions are adjacent, so a sub-chunk needs at most one command per axis.
+class MeshHeap {
+public:
+    static constexpr unsigned int PageVertexCount = 4 * 1024 * 1024;
+    static constexpr unsigned int PageIndexCount = 6 * 1024 * 1024;
+    static constexpr unsigned int PageDrawCount = 256;
+    static constexpr unsigned int SubChunkDrawCount = 3;
+    // Local size of culling.comp, one invocation per sub-chunk record.
+    static constexpr unsigned int CullingWorkGroupSize = 64;
+    // Culling statistics buffers in flight, so a frame can be read back while the GPU is still working on the
+    // ones after it.
+    static constexpr unsigned int CullingStatisticsFrameCount = 3;
+
+public:
+    MeshHeap();
+
+    ~MeshHeap();
+
+    // Overwrites allocation without freeing it, so a mesh can be copied from its old ranges before they are released.
+    bool Allocate(unsigned int vertexCount, unsigned int indexCount, MeshAllocation& allocation);
+
+    void Free(MeshAllocation& allocation);
+
+    void SetDraw(const MeshAllocation& allocation, unsigned int indexCount, const Vector3& origin, DrawRanges ranges, unsigned int level);
+
+    // depthPyramid may be null or invalid, which only disables occlusion culling.
+    void Draw(Shader* cullingShader, Shader* forwardShader, const DepthPyramid* depthPyramid);
+
+    GLuint GetVertexBufferId(unsigned int page) const;
+
+    GLuint GetIndexBufferId(unsigned int page) const;
+
+    GLuint GetVertexArrayId(unsigned int page) const;
+
+    GLuint GetDrawCommandBufferId(unsigned int page) const;
+
+    GLuint GetSubChunkFeedbackBufferId(unsigned int page) const;
+
+    MeshHeapStatistics GetStatistics() const;
+
+    // Counts of the latest frame whose culling has finished on the GPU, up to CullingStatisticsFrameCount
+    // frames behind.
+    const CullingStatistics& GetCullingStatistics() const;
+
+private:
+    struct Page {
+        GLuint VertexBufferId = 0;
+        GLuint IndexBufferId = 0;
+        GLuint VertexArrayId = 0;
+        GLuint DrawCommandBufferId = 0;
+        GLuint DrawDataBufferId = 0;
+        GLuint SubChunkFeedbackBufferId = 0;
+        GLuint VisibleDrawCommandBufferId = 0;
+        GLuint VisibleDrawCountBufferId = 0;
+        RangeAllocator Vertices;
+        RangeAllocator Indices;
+        RangeAllocator Draws;
+        unsigned int DrawCount = 0;
+        unsigned int Allocations = 0;
+    };
+
+    struct CullingStatisticsFrame {
+        GLuint BufferId = 0;
+        const CullingStatistics* MappedStatistics = nullptr;
+        // Set when the frame is submitted, cleared once its counters have been read.
+        GLsync Fence = 0;
+    };
+
+private:
+    unsigned int CreatePage(unsigned int vertexCount, unsigned int indexCount);
+
+    void DestroyPage(Page& page);
+
+private:
+    std::vector<Page> mPages;
+    unsigned int mVertexAlignment = 0;
+    unsigned int mIndexAlignment = 0;
+
+    CullingStatisticsFrame mCullingFrames[CullingStatisticsFrameCount];
+    unsigned int mCullingFrame = 0;
+    CullingStatistics mCullingStatistics;
+};
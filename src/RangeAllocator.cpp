@@ -0,0 +1,95 @@
+#include "RangeAllocator.hpp"
+
+#include <assert.h>
+
+RangeAllocator::RangeAllocator(unsigned int size, unsigned int alignment)
+    : mSize(size - size % alignment), mAlignment(alignment) {
+    if (mSize > 0) {
+        InsertFreeRange(0, mSize);
+    }
+}
+
+unsigned int RangeAllocator::Allocate(unsigned int size) {
+    size = AlignSize(size);
+
+    auto fit = mFreeBySize.lower_bound(size);
+    if (fit == mFreeBySize.end()) {
+        return InvalidOffset;
+    }
+
+    unsigned int offset = fit->second;
+    unsigned int freeSize = fit->first;
+
+    EraseFreeRange(mFreeByOffset.find(offset));
+
+    if (freeSize > size) {
+        InsertFreeRange(offset + size, freeSize - size);
+    }
+
+    mUsedSize += size;
+    return offset;
+}
+
+void RangeAllocator::Free(unsigned int offset, unsigned int size) {
+    size = AlignSize(size);
+    assert(offset + size <= mSize && size <= mUsedSize);
+
+    mUsedSize -= size;
+
+    auto next = mFreeByOffset.lower_bound(offset);
+    if (next != mFreeByOffset.end() && offset + size == next->first) {
+        size += next->second;
+        EraseFreeRange(next);
+    }
+
+    auto previous = mFreeByOffset.lower_bound(offset);
+    if (previous != mFreeByOffset.begin()) {
+        --previous;
+
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            EraseFreeRange(previous);
+        }
+    }
+
+    InsertFreeRange(offset, size);
+}
+
+unsigned int RangeAllocator::GetSize() const {
+    return mSize;
+}
+
+unsigned int RangeAllocator::GetUsedSize() const {
+    return mUsedSize;
+}
+
+unsigned int RangeAllocator::GetLargestFreeRange() const {
+    return mFreeBySize.empty() ? 0 : mFreeBySize.rbegin()->first;
+}
+
+unsigned int RangeAllocator::GetFreeRangeCount() const {
+    return (unsigned int)mFreeByOffset.size();
+}
+
+unsigned int RangeAllocator::AlignSize(unsigned int size) const {
+    size = size > 0 ? size : 1;
+    return (size + mAlignment - 1) / mAlignment * mAlignment;
+}
+
+void RangeAllocator::InsertFreeRange(unsigned int offset, unsigned int size) {
+    mFreeByOffset[offset] = size;
+    mFreeBySize.insert(std::make_pair(size, offset));
+}
+
+void RangeAllocator::EraseFreeRange(std::map<unsigned int, unsigned int>::iterator it) {
+    auto range = mFreeBySize.equal_range(it->second);
+    for (auto sizeIt = range.first; sizeIt != range.second; ++sizeIt) {
+        if (sizeIt->second == it->first) {
+            mFreeBySize.erase(sizeIt);
+            break;
+        }
+    }
+
+    mFreeByOffset.erase(it);
+}
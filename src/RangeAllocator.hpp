@@ -0,0 +1,40 @@
+#pragma once
+
+#include <map>
+
+// Hands out [offset, offset + size) ranges of a fixed-size space, e.g. elements of a GPU buffer. Sizes are
+// rounded up to the alignment, so every offset is aligned too. Free ranges are kept by offset, to merge a
+// released range with its neighbours, and by size, for best-fit allocation.
+class RangeAllocator {
+public:
+    static constexpr unsigned int InvalidOffset = 0xFFFFFFFF;
+
+public:
+    RangeAllocator(unsigned int size = 0, unsigned int alignment = 1);
+
+    unsigned int Allocate(unsigned int size);
+
+    void Free(unsigned int offset, unsigned int size);
+
+    unsigned int GetSize() const;
+
+    unsigned int GetUsedSize() const;
+
+    unsigned int GetLargestFreeRange() const;
+
+    unsigned int GetFreeRangeCount() const;
+
+private:
+    unsigned int AlignSize(unsigned int size) const;
+
+    void InsertFreeRange(unsigned int offset, unsigned int size);
+
+    void EraseFreeRange(std::map<unsigned int, unsigned int>::iterator it);
+
+private:
+    unsigned int mSize = 0;
+    unsigned int mAlignment = 1;
+    unsigned int mUsedSize = 0;
+    std::map<unsigned int, unsigned int> mFreeByOffset;
+    std::multimap<unsigned int, unsigned int> mFreeBySize;
+};
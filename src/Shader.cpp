@@ -1,76 +1,164 @@
 #include "Shader.hpp"
 
 #include <stdio.h>
-#include <stdlib.h>
 #include <assert.h>
 
-Shader::Shader(const char* computeShaderFilename) {
-    char* shaderCode = ReadAllText(computeShaderFilename);
+static bool sParallelCompilation = false;
 
-    CompileComputeShader(shaderCode);
+Shader::Shader(const char* computeShaderFilename, ShaderCache* cache, const ShaderDefines& defines) : mCache(cache) {
+    std::string filename = computeShaderFilename;
 
-    free(shaderCode);
+    mSources = std::async(std::launch::async, [filename, defines]() {
+        return std::vector<std::string>{ Preprocess(filename, defines) };
+    });
 }
 
-Shader::Shader(const char* vertexShaderFilename, const char* fragmentShaderFilename) {
-    char* vertexCode = ReadAllText(vertexShaderFilename);
-    char* fragmentCode = ReadAllText(fragmentShaderFilename);
+Shader::Shader(const char* vertexShaderFilename, const char* fragmentShaderFilename, ShaderCache* cache, const ShaderDefines& defines) : mCache(cache) {
+    std::string vertexFilename = vertexShaderFilename;
+    std::string fragmentFilename = fragmentShaderFilename;
 
-    CompileStandardShader(vertexCode, fragmentCode);
-
-    free(fragmentCode);
-    free(vertexCode);
+    mSources = std::async(std::launch::async, [vertexFilename, fragmentFilename, defines]() {
+        return std::vector<std::string>{ Preprocess(vertexFilename, defines), Preprocess(fragmentFilename, defines) };
+    });
 }
 
 Shader::~Shader() {
+    if (mSources.valid()) {
+        mSources.wait();
+    }
+
     glDeleteProgramPipelines(1, &mId);
+
+    glDeleteProgram(mComputeProgramId);
+    glDeleteProgram(mFragmentProgramId);
+    glDeleteProgram(mVertexProgramId);
+}
+
+bool Shader::EnableParallelCompilation() {
+    // 0xFFFFFFFF lets the driver pick the number of threads.
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        sParallelCompilation = true;
+    }
+    else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        sParallelCompilation = true;
+    }
+
+    return sParallelCompilation;
+}
+
+void Shader::Compile() {
+    if (mCompiled) {
+        return;
+    }
+
+    std::vector<std::string> sources = mSources.get();
+
+    if (sources.size() == 1) {
+        CompileComputeShader(sources[0].c_str());
+    }
+    else {
+        CompileStandardShader(sources[0].c_str(), sources[1].c_str());
+    }
+
+    mCompiled = true;
+}
+
+bool Shader::IsReady() const {
+    if (!mCompiled) {
+        return false;
+    }
+
+    if (mLinked || !sParallelCompilation) {
+        return true;
+    }
+
+    const GLuint programIds[] = { mVertexProgramId, mFragmentProgramId, mComputeProgramId };
+    for (GLuint programId : programIds) {
+        GLint completed = GL_TRUE;
+        if (programId) {
+            glGetProgramiv(programId, GL_COMPLETION_STATUS_KHR, &completed);
+        }
+
+        if (!completed) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
-GLuint Shader::GetId() const {
+GLuint Shader::GetId() {
+    Finish();
     return mId;
 }
 
-char* Shader::ReadAllText(const char* filename) {
-    FILE* file = fopen(filename, "rb");
-    assert(file);
+GLuint Shader::GetVertexProgramId() {
+    Finish();
+    return mVertexProgramId;
+}
+
+GLuint Shader::GetFragmentProgramId() {
+    Finish();
+    return mFragmentProgramId;
+}
 
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+GLuint Shader::GetComputeProgramId() {
+    Finish();
+    return mComputeProgramId;
+}
 
-    char* text = (char*)malloc(size + 1);
-    assert(text);
+std::string Shader::Preprocess(const std::string& filename, const ShaderDefines& defines) {
+    std::string source;
 
-    fread(text, 1, size, file);
-    text[size] = 0;
+    bool processed = ShaderPreprocessor(defines).Process(filename, source);
+    assert(processed);
+    (void)processed;
 
-    fclose(file);
-    return text;
+    return source;
 }
 
 void Shader::CompileStandardShader(const char* vertexShaderCode, const char* fragmentShaderCode) {
-    GLuint vertexShader = glCreateShaderProgramv(GL_VERTEX_SHADER, 1, &vertexShaderCode);
-
-    GLuint fragmentShader = glCreateShaderProgramv(GL_FRAGMENT_SHADER, 1, &fragmentShaderCode);
+    mVertexProgramId = CreateProgram(GL_VERTEX_SHADER, vertexShaderCode);
 
-    TestShader(vertexShader);
-    TestShader(fragmentShader);
+    mFragmentProgramId = CreateProgram(GL_FRAGMENT_SHADER, fragmentShaderCode);
 
     glCreateProgramPipelines(1, &mId);
-    glUseProgramStages(mId, GL_VERTEX_SHADER_BIT, vertexShader);
-    glUseProgramStages(mId, GL_FRAGMENT_SHADER_BIT, fragmentShader);
+    glUseProgramStages(mId, GL_VERTEX_SHADER_BIT, mVertexProgramId);
+    glUseProgramStages(mId, GL_FRAGMENT_SHADER_BIT, mFragmentProgramId);
 }
 
 void Shader::CompileComputeShader(const char* computeShaderCode) {
-    GLuint computeShader = glCreateShaderProgramv(GL_COMPUTE_SHADER, 1, &computeShaderCode);
-
-    TestShader(computeShader);
+    mComputeProgramId = CreateProgram(GL_COMPUTE_SHADER, computeShaderCode);
 
     glCreateProgramPipelines(1, &mId);
-    glUseProgramStages(mId, GL_COMPUTE_SHADER_BIT, computeShader);
+    glUseProgramStages(mId, GL_COMPUTE_SHADER_BIT, mComputeProgramId);
 }
 
-void Shader::TestShader(GLuint shaderId) {
+void Shader::Finish() {
+    if (mLinked) {
+        return;
+    }
+
+    Compile();
+
+    // The first query of the link status is what waits for the driver.
+    const GLuint programIds[] = { mVertexProgramId, mFragmentProgramId, mComputeProgramId };
+    for (GLuint programId : programIds) {
+        if (programId) {
+            TestShader(programId);
+
+            if (mCache) {
+                mCache->StoreProgram(programId);
+            }
+        }
+    }
+
+    mLinked = true;
+}
+
+void Shader::TestShader(GLuint shaderId) const {
     GLint result, infoLength;
     glGetProgramiv(shaderId, GL_LINK_STATUS, &result);
     glGetProgramiv(shaderId, GL_INFO_LOG_LENGTH, &infoLength);
@@ -80,4 +168,29 @@ void Shader::TestShader(GLuint shaderId) {
 
         printf("%s\n", buffer);
     }
+
+    // Programs compiled by the cache keep their shader attached until here, for its compile log.
+    GLuint attachedShaderIds[2];
+    GLsizei attachedCount = 0;
+    glGetAttachedShaders(shaderId, 2, &attachedCount, attachedShaderIds);
+    for (GLsizei i = 0; i < attachedCount; ++i) {
+        GLint compiled = GL_TRUE;
+        glGetShaderiv(attachedShaderIds[i], GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            char buffer[1024];
+            glGetShaderInfoLog(attachedShaderIds[i], 1023, NULL, buffer);
+
+            printf("%s\n", buffer);
+        }
+
+        glDetachShader(shaderId, attachedShaderIds[i]);
+    }
+}
+
+GLuint Shader::CreateProgram(GLenum type, const char* shaderCode) {
+    if (mCache) {
+        return mCache->CreateProgram(type, shaderCode);
+    }
+
+    return glCreateShaderProgramv(type, 1, &shaderCode);
 }
@@ -1,26 +1,69 @@
-#pragma once 
+#pragma once
 
 #include <GL/glew.h>
 
+#include "ShaderCache.hpp"
+#include "ShaderPreprocessor.hpp"
+
+#include <future>
+#include <string>
+#include <vector>
+
+// Shaders are created in stages so several can compile at once: the constructor only starts reading the
+// sources on a worker thread, Compile hands them to the driver without waiting for the result, and the link
+// status is checked the first time the pipeline is asked for. Callers that need the pipeline right away can
+// skip Compile, GetId does everything that is left.
 class Shader {
 public:
-    Shader(const char* computeShaderCode);
+    // Programs are taken from the cache when one is given and compiled from source otherwise. The sources go
+    // through ShaderPreprocessor with the defines, and the cache keys on the result, so every define set is a
+    // separate variant.
+    Shader(const char* computeShaderCode, ShaderCache* cache = nullptr, const ShaderDefines& defines = ShaderDefines());
 
-    Shader(const char* vertexShaderCode, const char* fragmentShaderCode);
+    Shader(const char* vertexShaderCode, const char* fragmentShaderCode, ShaderCache* cache = nullptr, const ShaderDefines& defines = ShaderDefines());
 
     ~Shader();
 
-    GLuint GetId() const;
+    // Lets the driver compile and link on its own threads (GL_KHR_parallel_shader_compile) so that Compile
+    // returns immediately; returns false if the extension is not available. Call once after creating the context.
+    static bool EnableParallelCompilation();
+
+    // Waits for the sources and starts compiling them.
+    void Compile();
+
+    // True once the programs finished linking and GetId would not block. Without GL_KHR_parallel_shader_compile
+    // this is the case as soon as Compile returned.
+    bool IsReady() const;
+
+    // Blocks until the programs are linked, the first time.
+    GLuint GetId();
+
+    GLuint GetVertexProgramId();
+
+    GLuint GetFragmentProgramId();
+
+    GLuint GetComputeProgramId();
 
 private:
-    char* ReadAllText(const char* filename);
+    static std::string Preprocess(const std::string& filename, const ShaderDefines& defines);
 
     void CompileStandardShader(const char* vertexShaderCode, const char* fragmentShaderCode);
 
     void CompileComputeShader(const char* computeShaderCode);
 
-    void TestShader(GLuint shaderId);
+    void Finish();
+
+    void TestShader(GLuint shaderId) const;
+
+    GLuint CreateProgram(GLenum type, const char* shaderCode);
 
 private:
+    ShaderCache* mCache = nullptr;
+    std::future<std::vector<std::string>> mSources;
     GLuint mId = 0;
+    GLuint mVertexProgramId = 0;
+    GLuint mFragmentProgramId = 0;
+    GLuint mComputeProgramId = 0;
+    bool mCompiled = false;
+    bool mLinked = false;
 };
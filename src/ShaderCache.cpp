@@ -0,0 +1,202 @@
+#include "ShaderCache.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+ShaderCache::ShaderCache(const char* directory) : mDirectory(directory) {
+    // Binaries are only valid for the driver that produced them, so its identity is part of every key.
+    mDriverKey = Hash(nullptr, 0);
+
+    const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (GLenum name : names) {
+        const char* value = (const char*)glGetString(name);
+        if (value) {
+            mDriverKey = Hash(value, strlen(value) + 1, mDriverKey);
+        }
+    }
+
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    mEnabled = formatCount > 0;
+}
+
+GLuint ShaderCache::CreateProgram(GLenum type, const char* source) {
+    if (!mEnabled) {
+        ++mMissCount;
+        return CompileProgram(type, source);
+    }
+
+    uint64_t key = Hash(&type, sizeof(type), mDriverKey);
+    key = Hash(source, strlen(source), key);
+
+    std::string filename = GetFilename(key);
+
+    GLuint programId = LoadProgram(filename, key);
+    if (programId) {
+        ++mHitCount;
+        return programId;
+    }
+
+    ++mMissCount;
+    programId = CompileProgram(type, source);
+    mPendingKeys[programId] = key;
+
+    return programId;
+}
+
+void ShaderCache::StoreProgram(GLuint programId) {
+    auto iterator = mPendingKeys.find(programId);
+    if (iterator == mPendingKeys.end()) {
+        return;
+    }
+
+    uint64_t key = iterator->second;
+    mPendingKeys.erase(iterator);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(programId, GL_LINK_STATUS, &linked);
+    if (linked) {
+        SaveProgram(GetFilename(key), key, programId);
+    }
+}
+
+unsigned int ShaderCache::GetHitCount() const {
+    return mHitCount;
+}
+
+unsigned int ShaderCache::GetMissCount() const {
+    return mMissCount;
+}
+
+GLuint ShaderCache::LoadProgram(const std::string& filename, uint64_t key) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+
+    ShaderCacheHeader header;
+    std::vector<unsigned char> binary;
+
+    bool valid = fread(&header, sizeof(header), 1, file) == 1
+        && header.Identifier == ShaderCacheHeader::Magic
+        && header.Version == ShaderCacheHeader::CurrentVersion
+        && header.Key == key
+        && header.DriverKey == mDriverKey
+        && header.BinarySize > 0;
+
+    if (valid) {
+        binary.resize(header.BinarySize);
+        valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+
+    fclose(file);
+
+    if (!valid) {
+        return 0;
+    }
+
+    GLuint programId = glCreateProgram();
+    glProgramParameteri(programId, GL_PROGRAM_SEPARABLE, GL_TRUE);
+    glProgramBinary(programId, header.BinaryFormat, binary.data(), (GLsizei)binary.size());
+
+    // Drivers reject binaries after an update even when the version string did not change; such programs are
+    // compiled again and the file is replaced.
+    GLint linked = GL_FALSE;
+    glGetProgramiv(programId, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        glDeleteProgram(programId);
+        return 0;
+    }
+
+    return programId;
+}
+
+void ShaderCache::SaveProgram(const std::string& filename, uint64_t key, GLuint programId) {
+    GLint binarySize = 0;
+    glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if (binarySize <= 0) {
+        return;
+    }
+
+    ShaderCacheHeader header = {};
+    header.Identifier = ShaderCacheHeader::Magic;
+    header.Version = ShaderCacheHeader::CurrentVersion;
+    header.Key = key;
+    header.DriverKey = mDriverKey;
+
+    std::vector<unsigned char> binary(binarySize);
+    GLenum binaryFormat = 0;
+    GLsizei length = 0;
+    glGetProgramBinary(programId, binarySize, &length, &binaryFormat, binary.data());
+    if (length <= 0) {
+        return;
+    }
+
+    header.BinaryFormat = binaryFormat;
+    header.BinarySize = (uint32_t)length;
+
+    if (!mDirectoryCreated) {
+#ifdef _WIN32
+        _mkdir(mDirectory.c_str());
+#else
+        mkdir(mDirectory.c_str(), 0755);
+#endif
+        mDirectoryCreated = true;
+    }
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(binary.data(), 1, header.BinarySize, file) == header.BinarySize;
+
+    fclose(file);
+
+    if (!written) {
+        remove(filename.c_str());
+    }
+}
+
+GLuint ShaderCache::CompileProgram(GLenum type, const char* source) const {
+    // Same as glCreateShaderProgramv, but with the retrievable hint set before linking so the binary can be read
+    // back afterwards. Nothing is queried here, which would wait for the driver; the shader is only flagged for
+    // deletion and goes away once it is detached.
+    GLuint shaderId = glCreateShader(type);
+    glShaderSource(shaderId, 1, &source, nullptr);
+    glCompileShader(shaderId);
+
+    GLuint programId = glCreateProgram();
+    glProgramParameteri(programId, GL_PROGRAM_SEPARABLE, GL_TRUE);
+    glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    glAttachShader(programId, shaderId);
+    glLinkProgram(programId);
+    glDeleteShader(shaderId);
+
+    return programId;
+}
+
+std::string ShaderCache::GetFilename(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+    return mDirectory + name;
+}
+
+uint64_t ShaderCache::Hash(const void* data, size_t size, uint64_t hash) {
+    // 64-bit FNV-1a.
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+// Header of a cached program binary. The file is named after Key; Key and DriverKey are repeated here so a
+// stale or colliding file is detected before its binary reaches the driver.
+struct ShaderCacheHeader {
+    static constexpr uint32_t Magic = 0x53474854; // "THGS"
+    static constexpr uint32_t CurrentVersion = 1;
+
+    uint32_t Identifier;
+    uint32_t Version;
+    uint64_t Key;
+    uint64_t DriverKey;
+    uint32_t BinaryFormat;
+    uint32_t BinarySize;
+};
+
+// Keeps linked separable programs as driver binaries in a directory, keyed by a hash of the stage, the source
+// and the GL vendor, renderer and version strings. Programs that are not cached, or whose binary the driver
+// rejects, are compiled from source and written back.
+class ShaderCache {
+public:
+    // Needs a current context. The directory is created on the first write.
+    ShaderCache(const char* directory = "shadercache");
+
+    // Returns a separable program, which is still compiling if it was not cached. The shader stays attached so
+    // the caller can report compile errors; link errors are left for the caller as well.
+    GLuint CreateProgram(GLenum type, const char* source);
+
+    // Writes the binary of a program that CreateProgram had to compile, once it is done linking, so asking for
+    // it does not stall the compilation of the others. Does nothing for programs that came from the cache.
+    void StoreProgram(GLuint programId);
+
+    unsigned int GetHitCount() const;
+
+    unsigned int GetMissCount() const;
+
+private:
+    GLuint LoadProgram(const std::string& filename, uint64_t key);
+
+    void SaveProgram(const std::string& filename, uint64_t key, GLuint programId);
+
+    GLuint CompileProgram(GLenum type, const char* source) const;
+
+    std::string GetFilename(uint64_t key) const;
+
+    static uint64_t Hash(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+private:
+    std::string mDirectory;
+    std::unordered_map<GLuint, uint64_t> mPendingKeys;
+    uint64_t mDriverKey = 0;
+    bool mEnabled = false;
+    bool mDirectoryCreated = false;
+    unsigned int mHitCount = 0;
+    unsigned int mMissCount = 0;
+};
@@ -0,0 +1,121 @@
+#include "ShaderPreprocessor.hpp"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+ShaderPreprocessor::ShaderPreprocessor(const ShaderDefines& defines) : mDefines(defines) {
+}
+
+bool ShaderPreprocessor::Process(const std::string& filename, std::string& source) {
+    mFilenames.clear();
+    source.clear();
+
+    return Append(filename, source);
+}
+
+const std::vector<std::string>& ShaderPreprocessor::GetFilenames() const {
+    return mFilenames;
+}
+
+bool ShaderPreprocessor::Append(const std::string& filename, std::string& source) {
+    if (std::find(mFilenames.begin(), mFilenames.end(), filename) != mFilenames.end()) {
+        return true;
+    }
+
+    std::string text;
+    if (!ReadAllText(filename, text)) {
+        return false;
+    }
+
+    const unsigned int fileIndex = (unsigned int)mFilenames.size();
+    mFilenames.push_back(filename);
+
+    const std::string directory = filename.substr(0, filename.find_last_of("/\\") + 1);
+
+    char line[64];
+
+    // Nothing may come before #version, so the root file starts without a #line.
+    if (fileIndex > 0) {
+        snprintf(line, sizeof(line), "#line 1 %u\n", fileIndex);
+        source += line;
+    }
+
+    size_t start = 0;
+    unsigned int lineNumber = 1;
+
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+
+        size_t length = end - start;
+        if (length > 0 && text[start + length - 1] == '\r') {
+            --length;
+        }
+
+        const char* current = text.c_str() + start;
+        const char* directive = current + strspn(current, " \t");
+
+        if (strncmp(directive, "#version", 8) == 0) {
+            // Only the root file keeps its #version; the defines go right after it.
+            if (fileIndex == 0) {
+                source.append(current, length);
+                source += '\n';
+
+                for (const ShaderDefine& define : mDefines) {
+                    source += "#define " + define.Name + " " + define.Value + "\n";
+                }
+
+                snprintf(line, sizeof(line), "#line %u %u\n", lineNumber + 1, fileIndex);
+                source += line;
+            }
+            else {
+                source += '\n';
+            }
+        }
+        else if (strncmp(directive, "#include", 8) == 0) {
+            const char* first = strchr(directive, '"');
+            const char* last = first ? strchr(first + 1, '"') : nullptr;
+            if (!last || last >= current + length) {
+                printf("%s(%u): malformed #include\n", filename.c_str(), lineNumber);
+                return false;
+            }
+
+            if (!Append(directory + std::string(first + 1, last), source)) {
+                return false;
+            }
+
+            snprintf(line, sizeof(line), "#line %u %u\n", lineNumber + 1, fileIndex);
+            source += line;
+        }
+        else {
+            source.append(current, length);
+            source += '\n';
+        }
+
+        start = end + 1;
+        ++lineNumber;
+    }
+
+    return true;
+}
+
+bool ShaderPreprocessor::ReadAllText(const std::string& filename, std::string& text) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        printf("Cannot open %s\n", filename.c_str());
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    text.resize(size);
+    bool read = fread(&text[0], 1, size, file) == (size_t)size;
+
+    fclose(file);
+    return read;
+}
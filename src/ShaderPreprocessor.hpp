@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct ShaderDefine {
+    std::string Name;
+    std::string Value;
+};
+
+typedef std::vector<ShaderDefine> ShaderDefines;
+
+// Resolves #include "file" lines, relative to the including file and once per file, and inserts a #define for
+// every define right after #version, so compile-time constants come from the C++ side instead of being copied
+// into each shader. #line directives keep error locations pointing into the original files: the source string
+// number is the index of the file in GetFilenames.
+class ShaderPreprocessor {
+public:
+    ShaderPreprocessor(const ShaderDefines& defines = ShaderDefines());
+
+    // False if filename or one of its includes cannot be read.
+    bool Process(const std::string& filename, std::string& source);
+
+    const std::vector<std::string>& GetFilenames() const;
+
+private:
+    bool Append(const std::string& filename, std::string& source);
+
+    static bool ReadAllText(const std::string& filename, std::string& text);
+
+private:
+    ShaderDefines mDefines;
+    std::vector<std::string> mFilenames;
+};
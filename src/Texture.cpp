@@ -1,38 +1,121 @@
 #include "Texture.hpp"
-
-#include <stb_image.h>
+#include "TextureFile.hpp"
 
 #include <assert.h>
 
-Texture::Texture(const char* filename) {
-    int width, height;
-    stbi_uc* pixels = stbi_load(filename, &width, &height, NULL, 4);
-    assert(pixels);
+Texture::Texture(const char* filename, const TextureOptions& options) {
+    // Baked containers are uploaded straight from the mapping, without copying or decoding anything.
+    TextureFile file;
+    if (file.Open(filename)) {
+        UploadFile(file);
+        return;
+    }
+
+    TextureImage image;
+    bool decoded = image.Decode(filename, options);
+    assert(decoded);
+    (void)decoded;
+
+    Upload(image);
+}
+
+Texture::Texture(const TextureFile& file) {
+    UploadFile(file);
+}
+
+Texture::Texture() {
+}
+
+Texture::~Texture() {
+    glDeleteTextures(1, &mId);
+}
+
+void Texture::Upload(const TextureImage& image, GLuint pixelBufferId, size_t pixelBufferOffset) {
+    UploadLevels(image, pixelBufferId ? nullptr : image.Data.data(), pixelBufferId, pixelBufferOffset);
+    mSize = image.Data.size();
+}
 
-    glCreateTextures(GL_TEXTURE_2D, 1, &mId);
+void Texture::UploadFile(const TextureFile& file) {
+    const TextureFileHeader& header = file.GetHeader();
+
+    TextureImage image;
+    image.InternalFormat = header.InternalFormat;
+    image.Array = (header.Flags & TextureFileHeader::ArrayFlag) != 0;
+    image.LayerCount = header.LayerCount;
+
+    image.Levels.resize(header.LevelCount);
+    for (uint32_t i = 0; i < header.LevelCount; ++i) {
+        const TextureFileLevel& level = file.GetLevels()[i];
+        image.Levels[i].Width = (int)level.Width;
+        image.Levels[i].Height = (int)level.Height;
+        image.Levels[i].Offset = (size_t)level.Offset;
+        image.Levels[i].Size = (size_t)level.Size;
+    }
+
+    UploadLevels(image, file.GetData(), 0, 0);
+    mSize = (size_t)header.DataSize;
+}
+
+void Texture::UploadLevels(const TextureImage& image, const unsigned char* data, GLuint pixelBufferId, size_t pixelBufferOffset) {
+    const bool compressed = image.InternalFormat != GL_RGBA8;
+    const GLsizei levelCount = (GLsizei)image.Levels.size();
+    const TextureLevel& base = image.Levels[0];
+
+    glCreateTextures(image.Array ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, 1, &mId);
 
     glTextureParameteri(mId, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTextureParameteri(mId, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTextureParameteri(mId, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(mId, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_NEAREST_MIPMAP_LINEAR : GL_NEAREST);
     glTextureParameteri(mId, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    glTextureStorage2D(mId, 1, GL_RGBA8, width, height);
-    glTextureSubImage2D(mId, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    if (image.Array) {
+        glTextureStorage3D(mId, levelCount, image.InternalFormat, base.Width, base.Height, image.LayerCount);
+    }
+    else {
+        glTextureStorage2D(mId, levelCount, image.InternalFormat, base.Width, base.Height);
+    }
+
+    // With a pixel buffer bound the data pointers are offsets into it and the copy does not wait for the driver
+    // to read client memory.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBufferId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    stbi_image_free(pixels);
+    for (GLsizei i = 0; i < levelCount; ++i) {
+        const TextureLevel& level = image.Levels[i];
+        const void* pixels = pixelBufferId ? (const void*)(pixelBufferOffset + level.Offset) : data + level.Offset;
 
-    mHandle = glGetTextureHandleARB(mId);
-    glMakeTextureHandleResidentARB(mHandle);
+        if (image.Array && compressed) {
+            glCompressedTextureSubImage3D(mId, i, 0, 0, 0, level.Width, level.Height, image.LayerCount, image.InternalFormat, (GLsizei)level.Size, pixels);
+        }
+        else if (image.Array) {
+            glTextureSubImage3D(mId, i, 0, 0, 0, level.Width, level.Height, image.LayerCount, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+        else if (compressed) {
+            glCompressedTextureSubImage2D(mId, i, 0, 0, level.Width, level.Height, image.InternalFormat, (GLsizei)level.Size, pixels);
+        }
+        else {
+            glTextureSubImage2D(mId, i, 0, 0, level.Width, level.Height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    mLayerCount = image.LayerCount;
 }
 
-Texture::~Texture() {
-    glDeleteTextures(1, &mId);
+bool Texture::IsReady() const {
+    return mId != 0;
 }
 
 GLuint Texture::GetId() const {
     return mId;
 }
 
-GLuint64 Texture::GetHandle() const {
-    return mHandle;
+unsigned int Texture::GetLayerCount() const {
+    return mLayerCount;
+}
+
+size_t Texture::GetSize() const {
+    return mSize;
 }
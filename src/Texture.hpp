@@ -1,18 +1,49 @@
-#pragma once 
+#pragma once
 
 #include <GL/glew.h>
 
+#include "TextureImage.hpp"
+
+#include <stddef.h>
+
+class TextureFile;
+
 class Texture {
 public:
-    Texture(const char* filename);
+    // Loads and uploads at once. Baked containers (see TextureFile) are mapped and uploaded as they are and
+    // ignore the options; anything else is decoded, see TextureLoader for doing that in the background.
+    Texture(const char* filename, const TextureOptions& options = TextureOptions());
+
+    // Uploads a container that is already open; the file can be closed afterwards.
+    Texture(const TextureFile& file);
+
+    // No storage until Upload.
+    Texture();
 
     ~Texture();
 
+    // Creates the storage and copies every level, from pixelBufferId if it is not 0, which then has to hold
+    // image.Data at pixelBufferOffset.
+    void Upload(const TextureImage& image, GLuint pixelBufferId = 0, size_t pixelBufferOffset = 0);
+
+    bool IsReady() const;
+
     GLuint GetId() const;
 
-    GLuint64 GetHandle() const;
+    // 1 for plain textures.
+    unsigned int GetLayerCount() const;
+
+    // Bytes of texture memory used by all levels.
+    size_t GetSize() const;
+
+private:
+    void UploadFile(const TextureFile& file);
+
+    // data is null when the levels come from pixelBufferId, starting at pixelBufferOffset.
+    void UploadLevels(const TextureImage& image, const unsigned char* data, GLuint pixelBufferId, size_t pixelBufferOffset);
 
 private:
     GLuint mId = 0;
-    GLuint64 mHandle = 0;
+    unsigned int mLayerCount = 1;
+    size_t mSize = 0;
 };
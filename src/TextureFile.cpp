@@ -0,0 +1,143 @@
+#include "TextureFile.hpp"
+
+#include <GL/glew.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Bytes of a level with the given format and dimensions, laid out like TextureImage::Data; 0 for formats that are
+// never baked.
+static uint64_t GetLevelSize(uint32_t internalFormat, uint64_t width, uint64_t height, uint64_t layerCount) {
+    switch (internalFormat) {
+    case GL_RGBA8:
+        return width * height * 4 * layerCount;
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        return ((width + 3) / 4) * ((height + 3) / 4) * 8 * layerCount;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return ((width + 3) / 4) * ((height + 3) / 4) * 16 * layerCount;
+    default:
+        return 0;
+    }
+}
+
+TextureFile::TextureFile() {
+}
+
+TextureFile::~TextureFile() {
+    Close();
+}
+
+bool TextureFile::Open(const char* filename) {
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    HANDLE mapping = GetFileSizeEx(file, &size) ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    mFileHandle = file;
+    mMappingHandle = mapping;
+    mSize = (size_t)size.QuadPart;
+    mMapping = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int file = open(filename, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        close(file);
+        return false;
+    }
+
+    // The mapping keeps the file alive on its own.
+    void* mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    mSize = (size_t)status.st_size;
+    mMapping = (const unsigned char*)mapping;
+#endif
+
+    if (!mMapping || mSize < sizeof(TextureFileHeader)) {
+        Close();
+        return false;
+    }
+
+    const TextureFileHeader& header = GetHeader();
+    const size_t levelsEnd = sizeof(TextureFileHeader) + sizeof(TextureFileLevel) * (size_t)header.LevelCount;
+
+    bool valid = header.Identifier == TextureFileHeader::Magic && header.Version == TextureFileHeader::CurrentVersion &&
+        header.LevelCount > 0 && header.LayerCount > 0 && levelsEnd <= header.DataOffset &&
+        header.DataOffset <= mSize && header.DataSize <= mSize - header.DataOffset;
+
+    for (uint32_t i = 0; valid && i < header.LevelCount; ++i) {
+        const TextureFileLevel& level = GetLevels()[i];
+        valid = level.Width > 0 && level.Height > 0 && level.Offset <= header.DataSize && level.Size <= header.DataSize - level.Offset &&
+            level.Size == GetLevelSize(header.InternalFormat, level.Width, level.Height, header.LayerCount);
+    }
+
+    if (!valid) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void TextureFile::Close() {
+#ifdef _WIN32
+    if (mMapping) {
+        UnmapViewOfFile(mMapping);
+    }
+
+    if (mMappingHandle) {
+        CloseHandle(mMappingHandle);
+    }
+
+    if (mFileHandle) {
+        CloseHandle(mFileHandle);
+    }
+
+    mFileHandle = nullptr;
+    mMappingHandle = nullptr;
+#else
+    if (mMapping) {
+        munmap((void*)mMapping, mSize);
+    }
+#endif
+
+    mMapping = nullptr;
+    mSize = 0;
+}
+
+const TextureFileHeader& TextureFile::GetHeader() const {
+    return *(const TextureFileHeader*)mMapping;
+}
+
+const TextureFileLevel* TextureFile::GetLevels() const {
+    return (const TextureFileLevel*)(mMapping + sizeof(TextureFileHeader));
+}
+
+const unsigned char* TextureFile::GetData() const {
+    return mMapping + GetHeader().DataOffset;
+}
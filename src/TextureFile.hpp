@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Baked texture container written by TextureBaker: the header, one TextureFileLevel per mip level, then the
+// level data at DataOffset, laid out exactly like TextureImage::Data so it can be uploaded without decoding.
+// Level offsets are relative to DataOffset, which is aligned to 16 bytes.
+struct TextureFileHeader {
+    static constexpr uint32_t Magic = 0x54474854; // "THGT"
+    static constexpr uint32_t CurrentVersion = 1;
+    static constexpr uint32_t ArrayFlag = 1;
+
+    uint32_t Identifier;
+    uint32_t Version;
+    uint32_t InternalFormat;
+    uint32_t Flags;
+    uint32_t LayerCount;
+    uint32_t LevelCount;
+    uint64_t DataOffset;
+    uint64_t DataSize;
+};
+
+struct TextureFileLevel {
+    uint32_t Width;
+    uint32_t Height;
+    uint64_t Offset;
+    uint64_t Size;
+};
+
+// A container mapped into memory read-only, so the levels go from the page cache straight to the driver.
+class TextureFile {
+public:
+    TextureFile();
+
+    ~TextureFile();
+
+    TextureFile(const TextureFile&) = delete;
+
+    TextureFile& operator=(const TextureFile&) = delete;
+
+    // False if the file cannot be mapped or is not a valid container, which includes levels whose size does not
+    // match their dimensions in the header's format.
+    bool Open(const char* filename);
+
+    void Close();
+
+    const TextureFileHeader& GetHeader() const;
+
+    const TextureFileLevel* GetLevels() const;
+
+    const unsigned char* GetData() const;
+
+private:
+    const unsigned char* mMapping = nullptr;
+    size_t mSize = 0;
+#ifdef _WIN32
+    void* mFileHandle = nullptr;
+    void* mMappingHandle = nullptr;
+#endif
+};
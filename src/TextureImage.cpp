@@ -0,0 +1,193 @@
+#include "TextureImage.hpp"
+#include "TextureFile.hpp"
+
+#include <stb_dxt.h>
+#include <stb_image.h>
+#include <stb_image_resize.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+// Compresses layerCount images of width x height texels, stored one after the other, into 4x4 blocks. Blocks
+// reaching past the edge of small levels repeat the last row and column.
+static void CompressLevel(const unsigned char* pixels, int width, int height, unsigned int layerCount, bool alpha, std::vector<unsigned char>& output) {
+    const size_t blockSize = alpha ? 16 : 8;
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+
+    size_t offset = output.size();
+    output.resize(offset + blockSize * blocksX * blocksY * layerCount);
+
+    unsigned char block[4 * 4 * 4];
+
+    for (unsigned int layer = 0; layer < layerCount; ++layer) {
+        const unsigned char* image = pixels + (size_t)layer * width * height * 4;
+
+        for (int blockY = 0; blockY < blocksY; ++blockY) {
+            for (int blockX = 0; blockX < blocksX; ++blockX) {
+                for (int y = 0; y < 4; ++y) {
+                    for (int x = 0; x < 4; ++x) {
+                        const int sourceX = std::min(blockX * 4 + x, width - 1);
+                        const int sourceY = std::min(blockY * 4 + y, height - 1);
+                        std::copy_n(image + ((size_t)sourceY * width + sourceX) * 4, 4, block + (y * 4 + x) * 4);
+                    }
+                }
+
+                stb_compress_dxt_block(output.data() + offset, block, alpha ? 1 : 0, STB_DXT_NORMAL);
+                offset += blockSize;
+            }
+        }
+    }
+}
+
+bool TextureImage::Decode(const char* filename, const TextureOptions& options) {
+    int width, height;
+    stbi_uc* pixels = stbi_load(filename, &width, &height, NULL, 4);
+    if (!pixels) {
+        return false;
+    }
+
+    Array = options.TileWidth > 0 && options.TileHeight > 0;
+
+    const int tileWidth = Array ? options.TileWidth : width;
+    const int tileHeight = Array ? options.TileHeight : height;
+    const int columns = width / tileWidth;
+    const int rows = height / tileHeight;
+    LayerCount = (unsigned int)(columns * rows);
+
+    // Reorder into one tile after the other, which is how the levels are laid out.
+    const size_t tileSize = (size_t)tileWidth * tileHeight * 4;
+    std::vector<unsigned char> base(tileSize * LayerCount);
+
+    for (int layer = 0; layer < (int)LayerCount; ++layer) {
+        const int tileX = (layer % columns) * tileWidth;
+        const int tileY = (layer / columns) * tileHeight;
+
+        for (int y = 0; y < tileHeight; ++y) {
+            const stbi_uc* source = pixels + ((size_t)(tileY + y) * width + tileX) * 4;
+            std::copy(source, source + tileWidth * 4, base.begin() + layer * tileSize + (size_t)y * tileWidth * 4);
+        }
+    }
+
+    stbi_image_free(pixels);
+
+    int levelCount = 1;
+    while (options.Mipmaps && ((tileWidth >> levelCount) > 0 || (tileHeight >> levelCount) > 0)) {
+        levelCount++;
+    }
+
+    switch (options.Compression) {
+    case TextureCompression::BC1:
+        InternalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        break;
+    case TextureCompression::BC3:
+        InternalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        break;
+    default:
+        InternalFormat = GL_RGBA8;
+        break;
+    }
+
+    Levels.clear();
+    Data.clear();
+
+    std::vector<unsigned char> level;
+
+    for (int i = 0; i < levelCount; ++i) {
+        TextureLevel info;
+        info.Width = std::max(tileWidth >> i, 1);
+        info.Height = std::max(tileHeight >> i, 1);
+        info.Offset = Data.size();
+
+        // Every level is filtered down from the base level, wrapping around the tile like the sampler does.
+        const unsigned char* levelPixels = base.data();
+        if (i > 0) {
+            const size_t levelTileSize = (size_t)info.Width * info.Height * 4;
+            level.resize(levelTileSize * LayerCount);
+
+            for (unsigned int layer = 0; layer < LayerCount; ++layer) {
+                stbir_resize_uint8_generic(base.data() + layer * tileSize, tileWidth, tileHeight, 0,
+                    level.data() + layer * levelTileSize, info.Width, info.Height, 0, 4, 3, 0,
+                    STBIR_EDGE_WRAP, STBIR_FILTER_BOX, STBIR_COLORSPACE_SRGB, NULL);
+            }
+
+            levelPixels = level.data();
+        }
+
+        if (options.Compression == TextureCompression::None) {
+            Data.insert(Data.end(), levelPixels, levelPixels + (size_t)info.Width * info.Height * 4 * LayerCount);
+        }
+        else {
+            CompressLevel(levelPixels, info.Width, info.Height, LayerCount, options.Compression == TextureCompression::BC3, Data);
+        }
+
+        info.Size = Data.size() - info.Offset;
+        Levels.push_back(info);
+    }
+
+    return true;
+}
+
+bool TextureImage::Load(const char* filename, const TextureOptions& options) {
+    TextureFile file;
+    if (!file.Open(filename)) {
+        return Decode(filename, options);
+    }
+
+    const TextureFileHeader& header = file.GetHeader();
+
+    InternalFormat = header.InternalFormat;
+    Array = (header.Flags & TextureFileHeader::ArrayFlag) != 0;
+    LayerCount = header.LayerCount;
+
+    Levels.resize(header.LevelCount);
+    for (uint32_t i = 0; i < header.LevelCount; ++i) {
+        const TextureFileLevel& level = file.GetLevels()[i];
+        Levels[i].Width = (int)level.Width;
+        Levels[i].Height = (int)level.Height;
+        Levels[i].Offset = (size_t)level.Offset;
+        Levels[i].Size = (size_t)level.Size;
+    }
+
+    Data.assign(file.GetData(), file.GetData() + header.DataSize);
+    return true;
+}
+
+bool TextureImage::Save(const char* filename) const {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        return false;
+    }
+
+    const size_t levelsEnd = sizeof(TextureFileHeader) + sizeof(TextureFileLevel) * Levels.size();
+
+    TextureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.Identifier = TextureFileHeader::Magic;
+    header.Version = TextureFileHeader::CurrentVersion;
+    header.InternalFormat = InternalFormat;
+    header.Flags = Array ? TextureFileHeader::ArrayFlag : 0;
+    header.LayerCount = LayerCount;
+    header.LevelCount = (uint32_t)Levels.size();
+    header.DataOffset = (levelsEnd + 15) & ~(size_t)15;
+    header.DataSize = Data.size();
+
+    std::vector<TextureFileLevel> levels(Levels.size());
+    for (size_t i = 0; i < Levels.size(); ++i) {
+        levels[i].Width = (uint32_t)Levels[i].Width;
+        levels[i].Height = (uint32_t)Levels[i].Height;
+        levels[i].Offset = Levels[i].Offset;
+        levels[i].Size = Levels[i].Size;
+    }
+
+    const unsigned char padding[16] = {};
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(levels.data(), sizeof(TextureFileLevel), levels.size(), file) == levels.size() &&
+        fwrite(padding, 1, header.DataOffset - levelsEnd, file) == header.DataOffset - levelsEnd &&
+        fwrite(Data.data(), 1, Data.size(), file) == Data.size();
+
+    return fclose(file) == 0 && written;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stddef.h>
+
+#include <vector>
+
+enum class TextureCompression {
+    None,
+    // 4 bits per texel, opaque.
+    BC1,
+    // 8 bits per texel, with alpha.
+    BC3
+};
+
+struct TextureOptions {
+    // Splits the image into tiles of this size, numbered row by row from the top left, and loads them as the
+    // layers of a GL_TEXTURE_2D_ARRAY. Each layer wraps and is mipmapped on its own, so nothing bleeds in from
+    // neighbouring tiles. 0 loads a plain 2D texture.
+    int TileWidth = 0;
+    int TileHeight = 0;
+    bool Mipmaps = true;
+    TextureCompression Compression = TextureCompression::None;
+};
+
+struct TextureLevel {
+    int Width = 0;
+    int Height = 0;
+    size_t Offset = 0;
+    size_t Size = 0;
+};
+
+// A texture with all its levels in memory, laid out the way they are uploaded: level after level and within a
+// level layer after layer, compressed levels as 4x4 blocks. Makes no OpenGL calls, so it can be built on any
+// thread and by the offline tools.
+struct TextureImage {
+    GLenum InternalFormat = GL_RGBA8;
+    bool Array = false;
+    unsigned int LayerCount = 1;
+    std::vector<TextureLevel> Levels;
+    std::vector<unsigned char> Data;
+
+    // Loads a baked container as is, anything else is decoded as an image with the given options.
+    bool Load(const char* filename, const TextureOptions& options = TextureOptions());
+
+    // Loads an image and builds its mip chain and compressed blocks.
+    bool Decode(const char* filename, const TextureOptions& options);
+
+    // Writes a container, see TextureFile.
+    bool Save(const char* filename) const;
+};
@@ -0,0 +1,184 @@
+#include "TextureLoader.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+// Enough for a block texture atlas with all its levels several times over. Larger images are uploaded straight
+// from the decoded data instead.
+static constexpr size_t StagingSize = 16 * 1024 * 1024;
+
+// Ranges start on cache lines, so that the copies into them stay aligned.
+static constexpr size_t StagingAlignment = 64;
+
+TextureLoader::TextureLoader(ThreadPool* threadPool)
+    : mThreadPool(threadPool) {
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glCreateBuffers(1, &mStagingBufferId);
+    glNamedBufferStorage(mStagingBufferId, StagingSize, 0, flags);
+
+    mStagingData = (unsigned char*)glMapNamedBufferRange(mStagingBufferId, 0, StagingSize, flags);
+}
+
+TextureLoader::~TextureLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+        mRequests.clear();
+    }
+
+    mThreadPool->Wait(mJobs);
+
+    for (StagingRange& range : mStagingRanges) {
+        if (range.Fence) {
+            glDeleteSync(range.Fence);
+        }
+    }
+
+    glUnmapNamedBuffer(mStagingBufferId);
+    glDeleteBuffers(1, &mStagingBufferId);
+}
+
+Texture* TextureLoader::Load(const char* filename, const TextureOptions& options) {
+    Texture* texture = new Texture();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRequests.push_back({ texture, filename, options });
+        mPending++;
+    }
+
+    mThreadPool->SubmitBackground([this]() { DecodeNextTexture(); }, &mJobs);
+    return texture;
+}
+
+void TextureLoader::Update() {
+    ReleaseStaging();
+
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        results.swap(mResults);
+    }
+
+    for (Result& result : results) {
+        if (!result.Decoded) {
+            continue;
+        }
+
+        if (!result.Staged) {
+            // The staging buffer was full or too small, so the driver copies from the decoded data instead.
+            result.Target->Upload(result.Image);
+            continue;
+        }
+
+        // The job already wrote the levels, the copy into the texture runs on the GPU timeline.
+        result.Target->Upload(result.Image, mStagingBufferId, result.StagingOffset);
+
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (StagingRange& range : mStagingRanges) {
+            if (range.Offset == result.StagingOffset && !range.Fence) {
+                range.Fence = fence;
+                break;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPending -= (unsigned int)results.size();
+}
+
+bool TextureLoader::IsIdle() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPending == 0;
+}
+
+void TextureLoader::DecodeNextTexture() {
+    Request request;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (!mRunning || mRequests.empty()) {
+            return;
+        }
+
+        request = mRequests.front();
+        mRequests.pop_front();
+    }
+
+    Result result;
+    result.Target = request.Target;
+    result.Decoded = result.Image.Load(request.Filename.c_str(), request.Options);
+    result.Staged = false;
+    result.StagingOffset = 0;
+
+    if (!result.Decoded) {
+        printf("Failed to load texture %s\n", request.Filename.c_str());
+    }
+    else {
+        const std::vector<unsigned char>& data = result.Image.Data;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            result.Staged = ReserveStaging(data.size(), result.StagingOffset);
+        }
+
+        // Nothing else touches the range until Update has issued the copy out of it.
+        if (result.Staged) {
+            memcpy(mStagingData + result.StagingOffset, data.data(), data.size());
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mResults.push_back(std::move(result));
+}
+
+bool TextureLoader::ReserveStaging(size_t size, size_t& offset) {
+    size = (size + StagingAlignment - 1) & ~(StagingAlignment - 1);
+
+    if (size == 0 || size > StagingSize) {
+        return false;
+    }
+
+    if (mStagingRanges.empty()) {
+        offset = 0;
+    }
+    else {
+        const size_t tail = mStagingRanges.front().Offset;
+
+        // Until the ranges wrap around, the space after the head and before the tail is free, afterwards only
+        // the space between them.
+        if (mStagingHead > tail && mStagingHead + size <= StagingSize) {
+            offset = mStagingHead;
+        }
+        else if (mStagingHead > tail && size <= tail) {
+            offset = 0;
+        }
+        else if (mStagingHead < tail && mStagingHead + size <= tail) {
+            offset = mStagingHead;
+        }
+        else {
+            return false;
+        }
+    }
+
+    mStagingRanges.push_back({ offset, size, 0 });
+    mStagingHead = offset + size;
+    return true;
+}
+
+void TextureLoader::ReleaseStaging() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    while (!mStagingRanges.empty() && mStagingRanges.front().Fence) {
+        GLint status = GL_UNSIGNALED;
+        glGetSynciv(mStagingRanges.front().Fence, GL_SYNC_STATUS, 1, NULL, &status);
+
+        if (status != GL_SIGNALED) {
+            return;
+        }
+
+        glDeleteSync(mStagingRanges.front().Fence);
+        mStagingRanges.pop_front();
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Texture.hpp"
+#include "ThreadPool.hpp"
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Loads textures in the background. Reading, decoding, mip generation and block compression run as background
+// jobs on the thread pool, which needs at least one worker. The jobs also copy the finished levels into a
+// persistently mapped staging buffer, so Update on the GL thread only issues the copies into the textures, and
+// the driver reads them from the buffer without stalling the main thread. Textures returned by Load have no
+// storage until then (Texture::IsReady) and must not be deleted before they are ready or the loader is destroyed.
+class TextureLoader {
+public:
+    TextureLoader(ThreadPool* threadPool);
+
+    ~TextureLoader();
+
+    Texture* Load(const char* filename, const TextureOptions& options = TextureOptions());
+
+    // Uploads the textures that finished decoding; call once per frame.
+    void Update();
+
+    // True when nothing is waiting to be decoded or uploaded.
+    bool IsIdle();
+
+private:
+    struct Request {
+        Texture* Target;
+        std::string Filename;
+        TextureOptions Options;
+    };
+
+    struct Result {
+        Texture* Target;
+        TextureImage Image;
+        bool Decoded;
+        bool Staged;
+        size_t StagingOffset;
+    };
+
+    // Part of the staging buffer in use, in the order it was reserved. Fence is set once the copy out of it has
+    // been issued; the range is free again when it has signaled.
+    struct StagingRange {
+        size_t Offset;
+        size_t Size;
+        GLsync Fence;
+    };
+
+private:
+    // Decodes the first requested texture, if any; one job is queued per request.
+    void DecodeNextTexture();
+
+    // Reserves size bytes after the newest range, wrapping around to the start; false when they do not fit.
+    // Needs mMutex.
+    bool ReserveStaging(size_t size, size_t& offset);
+
+    // Frees the oldest ranges whose copies are done.
+    void ReleaseStaging();
+
+private:
+    ThreadPool* mThreadPool = nullptr;
+    JobCounter mJobs;
+    std::mutex mMutex;
+    std::deque<Request> mRequests;
+    std::vector<Result> mResults;
+    unsigned int mPending = 0;
+    bool mRunning = true;
+
+    GLuint mStagingBufferId = 0;
+    unsigned char* mStagingData = nullptr;
+    std::deque<StagingRange> mStagingRanges;
+    size_t mStagingHead = 0;
+};
@@ -0,0 +1,232 @@
+#include "ThreadPool.hpp"
+
+// The pool and deque of the current thread if it is a worker.
+static thread_local const ThreadPool* sCurrentPool = nullptr;
+static thread_local unsigned int sCurrentQueue = 0;
+
+bool JobCounter::IsDone() const {
+    return Pending.load() == 0;
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : mQueuedJobs(0) {
+    for (unsigned int i = 0; i <= threadCount; ++i) {
+        mQueues.emplace_back(new Queue());
+    }
+
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        mThreads.emplace_back(&ThreadPool::WorkerLoop, this, i + 1);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+    }
+
+    mWorkCondition.notify_all();
+
+    for (std::thread& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& function) {
+    if (mThreads.empty() || count <= 1) {
+        for (unsigned int i = 0; i < count; ++i) {
+            function(i);
+        }
+
+        return;
+    }
+
+    // A few pieces per thread leave room for stealing when the indices take uneven time.
+    unsigned int grain = count / (GetThreadCount() * 4);
+    grain = grain > 0 ? grain : 1;
+
+    JobCounter counter;
+    RunRange(0, count, grain, function, counter);
+    Wait(counter);
+}
+
+void ThreadPool::Submit(std::function<void()> function, JobCounter* counter, JobCounter* dependency) {
+    if (counter) {
+        counter->Pending++;
+    }
+
+    Job job;
+    job.Function = std::move(function);
+    job.Counter = counter;
+
+    if (dependency) {
+        std::lock_guard<std::mutex> lock(dependency->Mutex);
+        if (dependency->Pending.load() > 0) {
+            // Shared so the closure stays copyable for std::function.
+            std::shared_ptr<Job> held = std::make_shared<Job>(std::move(job));
+            dependency->Dependents.push_back([this, held]() { Push(std::move(*held), false); });
+            return;
+        }
+    }
+
+    Push(std::move(job), false);
+}
+
+void ThreadPool::SubmitBackground(std::function<void()> function, JobCounter* counter) {
+    if (counter) {
+        counter->Pending++;
+    }
+
+    Job job;
+    job.Function = std::move(function);
+    job.Counter = counter;
+
+    Push(std::move(job), true);
+}
+
+void ThreadPool::Wait(JobCounter& counter) {
+    const unsigned int queueIndex = GetQueueIndex();
+
+    while (!counter.IsDone()) {
+        Job job;
+        if (TakeJob(queueIndex, false, job)) {
+            Run(job);
+        }
+        else {
+            // The remaining jobs of the counter are running on other threads.
+            std::this_thread::yield();
+        }
+    }
+
+    // The last job decrements the counter under its lock; once the lock is free it is done with the counter,
+    // which the caller may destroy as soon as this returns.
+    std::lock_guard<std::mutex> lock(counter.Mutex);
+}
+
+unsigned int ThreadPool::GetThreadCount() const {
+    return (unsigned int)mThreads.size() + 1;
+}
+
+unsigned int ThreadPool::DefaultThreadCount() {
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+void ThreadPool::WorkerLoop(unsigned int queueIndex) {
+    sCurrentPool = this;
+    sCurrentQueue = queueIndex;
+
+    while (true) {
+        Job job;
+        if (TakeJob(queueIndex, true, job)) {
+            Run(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWorkCondition.wait(lock, [this] { return !mRunning || mQueuedJobs.load() > 0; });
+
+        if (!mRunning) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::Push(Job job, bool background) {
+    Queue& queue = background ? mBackgroundQueue : *mQueues[GetQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        queue.Jobs.push_back(std::move(job));
+    }
+
+    mQueuedJobs++;
+
+    // Taking the lock orders the count with a worker that is about to go to sleep, so the wake up is not lost.
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+    }
+
+    mWorkCondition.notify_one();
+}
+
+bool ThreadPool::TakeJob(unsigned int queueIndex, bool background, Job& job) {
+    const unsigned int queueCount = (unsigned int)mQueues.size();
+
+    for (unsigned int i = 0; i < queueCount; ++i) {
+        Queue& queue = *mQueues[(queueIndex + i) % queueCount];
+
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if (queue.Jobs.empty()) {
+            continue;
+        }
+
+        // Newest first from the own deque, keeping its data in cache; oldest, and so largest, when stealing.
+        if (i == 0) {
+            job = std::move(queue.Jobs.back());
+            queue.Jobs.pop_back();
+        }
+        else {
+            job = std::move(queue.Jobs.front());
+            queue.Jobs.pop_front();
+        }
+
+        mQueuedJobs--;
+        return true;
+    }
+
+    if (background) {
+        std::lock_guard<std::mutex> lock(mBackgroundQueue.Mutex);
+        if (!mBackgroundQueue.Jobs.empty()) {
+            job = std::move(mBackgroundQueue.Jobs.front());
+            mBackgroundQueue.Jobs.pop_front();
+
+            mQueuedJobs--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::Run(Job& job) {
+    job.Function();
+
+    JobCounter* counter = job.Counter;
+    if (!counter) {
+        return;
+    }
+
+    // The last job of a counter releases the jobs that depend on it.
+    std::vector<std::function<void()>> dependents;
+    {
+        std::lock_guard<std::mutex> lock(counter->Mutex);
+        if (--counter->Pending == 0) {
+            dependents.swap(counter->Dependents);
+        }
+    }
+
+    for (std::function<void()>& dependent : dependents) {
+        dependent();
+    }
+}
+
+void ThreadPool::RunRange(unsigned int first, unsigned int last, unsigned int grain, const std::function<void(unsigned int)>& function, JobCounter& counter) {
+    // Splits off the upper half until the range is small enough, each half as a job for others to steal.
+    while (last - first > grain) {
+        unsigned int middle = first + (last - first) / 2;
+
+        Submit([this, middle, last, grain, &function, &counter]() {
+            RunRange(middle, last, grain, function, counter);
+        }, &counter);
+
+        last = middle;
+    }
+
+    for (unsigned int i = first; i < last; ++i) {
+        function(i);
+    }
+}
+
+unsigned int ThreadPool::GetQueueIndex() const {
+    return sCurrentPool == this ? sCurrentQueue : 0;
+}
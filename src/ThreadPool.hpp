@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of unfinished jobs submitted with it. ThreadPool::Wait returns once it drops to zero, and jobs that
+// name it as their dependency are queued only then. A counter must not be destroyed before Wait on it returned
+// and must not be reused while jobs still depend on it.
+struct JobCounter {
+    std::atomic<unsigned int> Pending{ 0 };
+
+    // Queues the jobs that depend on this counter, see ThreadPool::Submit.
+    std::mutex Mutex;
+    std::vector<std::function<void()>> Dependents;
+
+    bool IsDone() const;
+};
+
+// Work-stealing scheduler shared by everything that runs in the background. Every worker owns a deque: it
+// takes its newest job first, and when it runs dry it steals the oldest job of another deque, so recursively
+// split work spreads out in large pieces. Threads outside the pool share one more deque. Background jobs
+// (chunk generation, texture decoding) wait in a separate queue that only workers take from, once there is
+// nothing else to do, so that a thread helping out in Wait never picks up a long job and stalls its frame.
+class ThreadPool {
+public:
+    // threadCount is the number of worker threads; the calling thread always takes part in ParallelFor as well.
+    // Background jobs need at least one worker.
+    ThreadPool(unsigned int threadCount = DefaultThreadCount());
+
+    // Workers stop after their current job; anything still queued is dropped, so wait for counters first.
+    ~ThreadPool();
+
+    // Calls function for every index in [0, count) and returns when all calls are done. The range is split in
+    // halves down to a few chunks per thread; the halves are left for other threads to steal.
+    void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& function);
+
+    // Queues a job, counted in counter if it is not null. With a dependency the job is held back until all jobs
+    // of that counter are done.
+    void Submit(std::function<void()> function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+    // Queues a long job that only workers run.
+    void SubmitBackground(std::function<void()> function, JobCounter* counter = nullptr);
+
+    // Runs queued jobs on the calling thread until counter is done, instead of blocking.
+    void Wait(JobCounter& counter);
+
+    unsigned int GetThreadCount() const;
+
+    static unsigned int DefaultThreadCount();
+
+private:
+    struct Job {
+        std::function<void()> Function;
+        JobCounter* Counter = nullptr;
+    };
+
+    struct Queue {
+        std::mutex Mutex;
+        std::deque<Job> Jobs;
+    };
+
+private:
+    void WorkerLoop(unsigned int queueIndex);
+
+    void Push(Job job, bool background);
+
+    bool TakeJob(unsigned int queueIndex, bool background, Job& job);
+
+    void Run(Job& job);
+
+    void RunRange(unsigned int first, unsigned int last, unsigned int grain, const std::function<void(unsigned int)>& function, JobCounter& counter);
+
+    // Deque of the calling thread: its own for workers, the shared one for everything else.
+    unsigned int GetQueueIndex() const;
+
+private:
+    std::vector<std::thread> mThreads;
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    Queue mBackgroundQueue;
+    std::atomic<int> mQueuedJobs;
+
+    std::mutex mMutex;
+    std::condition_variable mWorkCondition;
+    bool mRunning = true;
+};
@@ -0,0 +1,368 @@
+#include "VoxelStorage.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#   include <emmintrin.h>
+#   define VOXEL_STORAGE_SSE2
+#endif
+
+// Index (un)packing for a fixed index width of 1 << BitsShift bits. With the width known, whole words are
+// packed and unpacked with constant shifts that the compiler can unroll; only the partial words
+// at the ends of a range go index by index.
+template <unsigned int BitsShift, typename Output>
+static void DecodeWords(const unsigned int* words, unsigned int first, unsigned int count, Output output) {
+    constexpr unsigned int IndicesPerWord = 32 >> BitsShift;
+    constexpr unsigned int Mask = (unsigned int)((1ull << (1u << BitsShift)) - 1);
+
+    unsigned int i = 0;
+    for (; i < count && (first + i) % IndicesPerWord != 0; ++i) {
+        unsigned int index = first + i;
+        output(i, (words[index / IndicesPerWord] >> ((index % IndicesPerWord) << BitsShift)) & Mask);
+    }
+
+    for (; i + IndicesPerWord <= count; i += IndicesPerWord) {
+        unsigned int word = words[(first + i) / IndicesPerWord];
+        for (unsigned int j = 0; j < IndicesPerWord; ++j) {
+            output(i + j, (word >> (j << BitsShift)) & Mask);
+        }
+    }
+
+    for (; i < count; ++i) {
+        unsigned int index = first + i;
+        output(i, (words[index / IndicesPerWord] >> ((index % IndicesPerWord) << BitsShift)) & Mask);
+    }
+}
+
+template <typename Output>
+static void DecodeWords(unsigned int bitsShift, const unsigned int* words, unsigned int first, unsigned int count, Output output) {
+    switch (bitsShift) {
+    case 0: DecodeWords<0>(words, first, count, output); break;
+    case 1: DecodeWords<1>(words, first, count, output); break;
+    case 2: DecodeWords<2>(words, first, count, output); break;
+    case 3: DecodeWords<3>(words, first, count, output); break;
+    case 4: DecodeWords<4>(words, first, count, output); break;
+    default: DecodeWords<5>(words, first, count, output); break;
+    }
+}
+
+template <unsigned int BitsShift>
+static bool WriteWords(unsigned int* words, unsigned int first, unsigned int count, const unsigned int* indices) {
+    constexpr unsigned int IndicesPerWord = 32 >> BitsShift;
+    constexpr unsigned int Mask = (unsigned int)((1ull << (1u << BitsShift)) - 1);
+
+    unsigned int differences = 0;
+
+    auto writeIndex = [&](unsigned int i) {
+        unsigned int index = first + i;
+        unsigned int shift = (index % IndicesPerWord) << BitsShift;
+        unsigned int& word = words[index / IndicesPerWord];
+        unsigned int value = (word & ~(Mask << shift)) | (indices[i] << shift);
+        differences |= word ^ value;
+        word = value;
+    };
+
+    unsigned int i = 0;
+    for (; i < count && (first + i) % IndicesPerWord != 0; ++i) {
+        writeIndex(i);
+    }
+
+    for (; i + IndicesPerWord <= count; i += IndicesPerWord) {
+        unsigned int pattern = 0;
+        for (unsigned int j = 0; j < IndicesPerWord; ++j) {
+            pattern |= indices[i + j] << (j << BitsShift);
+        }
+
+        unsigned int& word = words[(first + i) / IndicesPerWord];
+        differences |= word ^ pattern;
+        word = pattern;
+    }
+
+    for (; i < count; ++i) {
+        writeIndex(i);
+    }
+
+    return differences != 0;
+}
+
+VoxelStorage::VoxelStorage(unsigned int size)
+    : mSize(size) {
+    mWords = (unsigned int*)calloc(((size << mBitsShift) + 31) / 32, sizeof(unsigned int));
+    assert(mWords);
+
+    mPalette.push_back(0);
+    mPaletteLookup[0] = 0;
+}
+
+VoxelStorage::~VoxelStorage() {
+    free(mWords);
+}
+
+unsigned int VoxelStorage::GetVoxel(unsigned int index) const {
+    return mPalette[GetIndex(index)];
+}
+
+bool VoxelStorage::SetVoxel(unsigned int index, unsigned int value) {
+    if (mPalette[GetIndex(index)] == value) {
+        return false;
+    }
+
+    SetIndex(index, GetPaletteIndex(value));
+    return true;
+}
+
+bool VoxelStorage::Fill(unsigned int first, unsigned int count, unsigned int value) {
+    if (count == 0) {
+        return false;
+    }
+
+    unsigned int pattern = GetPaletteIndex(value);
+    for (unsigned int bits = mBitsPerIndex; bits < 32; bits *= 2) {
+        pattern |= pattern << bits;
+    }
+
+    unsigned int firstBit = first << mBitsShift;
+    unsigned int lastBit = (first + count) << mBitsShift;
+    unsigned int firstWord = firstBit >> 5;
+    unsigned int lastWord = lastBit >> 5;
+
+    if (firstWord == lastWord) {
+        unsigned int mask = ((1u << (lastBit & 31)) - 1) & ~((1u << (firstBit & 31)) - 1);
+        return FillWord(firstWord, mask, pattern);
+    }
+
+    bool changed = false;
+
+    if (firstBit & 31) {
+        changed |= FillWord(firstWord, ~((1u << (firstBit & 31)) - 1), pattern);
+        firstWord++;
+    }
+
+    if (lastBit & 31) {
+        changed |= FillWord(lastWord, (1u << (lastBit & 31)) - 1, pattern);
+    }
+
+    unsigned int word = firstWord;
+
+#ifdef VOXEL_STORAGE_SSE2
+    const __m128i patterns = _mm_set1_epi32((int)pattern);
+    __m128i differences = _mm_setzero_si128();
+
+    for (; word + 4 <= lastWord; word += 4) {
+        __m128i* words = (__m128i*)(mWords + word);
+        differences = _mm_or_si128(differences, _mm_xor_si128(_mm_loadu_si128(words), patterns));
+        _mm_storeu_si128(words, patterns);
+    }
+
+    changed |= _mm_movemask_epi8(_mm_cmpeq_epi8(differences, _mm_setzero_si128())) != 0xFFFF;
+#endif
+
+    for (; word < lastWord; ++word) {
+        changed |= mWords[word] != pattern;
+        mWords[word] = pattern;
+    }
+
+    return changed;
+}
+
+bool VoxelStorage::Write(unsigned int first, unsigned int count, const unsigned int* values) {
+    const unsigned int BlockSize = 256;
+    const unsigned int CacheBits = 6;
+
+    // Recently resolved values, direct-mapped by a multiplicative hash; an index of 0 marks an empty slot, so
+    // the stored index is one higher. Cleared whenever a compaction renumbers the palette.
+    unsigned int cacheValues[1 << CacheBits];
+    unsigned int cacheIndices[1 << CacheBits];
+    unsigned int cacheVersion = mPaletteVersion;
+    memset(cacheIndices, 0, sizeof(cacheIndices));
+
+    unsigned int indices[BlockSize];
+    bool changed = false;
+
+    for (unsigned int offset = 0; offset < count; offset += BlockSize) {
+        unsigned int blockCount = count - offset < BlockSize ? count - offset : BlockSize;
+        const unsigned int* blockValues = values + offset;
+
+        // Indices resolved earlier in the block are not referenced by the storage yet, so a compaction
+        // mid-block invalidates them. Retry once with compaction disabled, which can only grow the palette.
+        unsigned int paletteVersion = mPaletteVersion;
+        for (bool compact = true;; compact = false) {
+            if (cacheVersion != mPaletteVersion) {
+                cacheVersion = mPaletteVersion;
+                memset(cacheIndices, 0, sizeof(cacheIndices));
+            }
+
+            for (unsigned int i = 0; i < blockCount; ++i) {
+                unsigned int value = blockValues[i];
+                unsigned int slot = (value * 2654435761u) >> (32 - CacheBits);
+
+                if (cacheIndices[slot] == 0 || cacheValues[slot] != value) {
+                    cacheValues[slot] = value;
+                    cacheIndices[slot] = GetPaletteIndex(value, compact) + 1;
+                }
+
+                indices[i] = cacheIndices[slot] - 1;
+            }
+
+            if (paletteVersion == mPaletteVersion) {
+                break;
+            }
+
+            paletteVersion = mPaletteVersion;
+        }
+
+        changed |= WriteIndices(first + offset, blockCount, indices);
+    }
+
+    return changed;
+}
+
+void VoxelStorage::Decode(unsigned int first, unsigned int count, unsigned int* output) const {
+    const unsigned int* palette = mPalette.data();
+
+    DecodeWords(mBitsShift, mWords, first, count, [output, palette](unsigned int i, unsigned int index) {
+        output[i] = palette[index];
+    });
+}
+
+unsigned int VoxelStorage::GetSize() const {
+    return mSize;
+}
+
+unsigned int VoxelStorage::GetBitsPerIndex() const {
+    return mBitsPerIndex;
+}
+
+unsigned int VoxelStorage::GetPaletteSize() const {
+    return (unsigned int)mPalette.size();
+}
+
+size_t VoxelStorage::GetMemoryUsage() const {
+    size_t wordsSize = (((size_t)mSize << mBitsShift) + 31) / 32 * sizeof(unsigned int);
+    size_t paletteSize = mPalette.capacity() * sizeof(unsigned int);
+    size_t lookupSize = mPaletteLookup.bucket_count() * sizeof(void*) + mPaletteLookup.size() * (sizeof(void*) + 2 * sizeof(unsigned int));
+    return sizeof(VoxelStorage) + wordsSize + paletteSize + lookupSize;
+}
+
+unsigned int VoxelStorage::GetPaletteIndex(unsigned int value, bool compact) {
+    if (mPalette.size() <= 16) {
+        for (unsigned int i = 0; i < mPalette.size(); ++i) {
+            if (mPalette[i] == value) {
+                return i;
+            }
+        }
+    }
+    else {
+        auto it = mPaletteLookup.find(value);
+        if (it != mPaletteLookup.end()) {
+            return it->second;
+        }
+    }
+
+    if (mPalette.size() > mIndexMask) {
+        if (compact) {
+            Compact();
+        }
+
+        // At MaxBitsPerIndex every 32-bit value has an index, so this only grows up to there.
+        if (mPalette.size() > mIndexMask) {
+            Resize(mBitsPerIndex * 2);
+        }
+    }
+
+    unsigned int paletteIndex = (unsigned int)mPalette.size();
+    mPalette.push_back(value);
+    mPaletteLookup[value] = paletteIndex;
+    return paletteIndex;
+}
+
+unsigned int VoxelStorage::GetIndex(unsigned int index) const {
+    unsigned int bit = index << mBitsShift;
+    return (mWords[bit >> 5] >> (bit & 31)) & mIndexMask;
+}
+
+void VoxelStorage::SetIndex(unsigned int index, unsigned int paletteIndex) {
+    unsigned int bit = index << mBitsShift;
+    unsigned int& word = mWords[bit >> 5];
+    word = (word & ~(mIndexMask << (bit & 31))) | (paletteIndex << (bit & 31));
+}
+
+void VoxelStorage::DecodeIndices(unsigned int first, unsigned int count, unsigned int* indices) const {
+    DecodeWords(mBitsShift, mWords, first, count, [indices](unsigned int i, unsigned int index) {
+        indices[i] = index;
+    });
+}
+
+bool VoxelStorage::WriteIndices(unsigned int first, unsigned int count, const unsigned int* indices) {
+    switch (mBitsShift) {
+    case 0: return WriteWords<0>(mWords, first, count, indices);
+    case 1: return WriteWords<1>(mWords, first, count, indices);
+    case 2: return WriteWords<2>(mWords, first, count, indices);
+    case 3: return WriteWords<3>(mWords, first, count, indices);
+    case 4: return WriteWords<4>(mWords, first, count, indices);
+    default: return WriteWords<5>(mWords, first, count, indices);
+    }
+}
+
+bool VoxelStorage::FillWord(unsigned int word, unsigned int mask, unsigned int pattern) {
+    unsigned int value = (mWords[word] & ~mask) | (pattern & mask);
+    bool changed = value != mWords[word];
+    mWords[word] = value;
+    return changed;
+}
+
+void VoxelStorage::Compact() {
+    std::vector<unsigned int> uses(mPalette.size(), 0);
+    for (unsigned int i = 0; i < mSize; ++i) {
+        uses[GetIndex(i)]++;
+    }
+
+    std::vector<unsigned int> remap(mPalette.size(), 0);
+    std::vector<unsigned int> palette;
+    for (unsigned int i = 0; i < mPalette.size(); ++i) {
+        if (uses[i] > 0) {
+            remap[i] = (unsigned int)palette.size();
+            palette.push_back(mPalette[i]);
+        }
+    }
+
+    if (palette.size() == mPalette.size()) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < mSize; ++i) {
+        SetIndex(i, remap[GetIndex(i)]);
+    }
+
+    mPalette.swap(palette);
+    mPaletteVersion++;
+
+    mPaletteLookup.clear();
+    for (unsigned int i = 0; i < mPalette.size(); ++i) {
+        mPaletteLookup[mPalette[i]] = i;
+    }
+}
+
+void VoxelStorage::Resize(unsigned int bitsPerIndex) {
+    unsigned int bitsShift = 0;
+    while ((1u << bitsShift) < bitsPerIndex) {
+        bitsShift++;
+    }
+
+    unsigned int* words = (unsigned int*)calloc(((mSize << bitsShift) + 31) / 32, sizeof(unsigned int));
+    assert(words);
+
+    for (unsigned int i = 0; i < mSize; ++i) {
+        unsigned int bit = i << bitsShift;
+        words[bit >> 5] |= GetIndex(i) << (bit & 31);
+    }
+
+    free(mWords);
+
+    mWords = words;
+    mBitsPerIndex = bitsPerIndex;
+    mBitsShift = bitsShift;
+    mIndexMask = bitsPerIndex < 32 ? (1u << bitsPerIndex) - 1 : 0xFFFFFFFF;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <unordered_map>
+#include <vector>
+
+class VoxelStorage {
+public:
+    // Past 16 bits the indices are as wide as the values, so the palette no longer saves memory, but a chunk
+    // with that many distinct values still works.
+    static constexpr unsigned int MaxBitsPerIndex = 32;
+
+public:
+    VoxelStorage(unsigned int size);
+
+    ~VoxelStorage();
+
+    // Owns mWords, and a copy of a chunk's voxels is never wanted.
+    VoxelStorage(const VoxelStorage&) = delete;
+
+    VoxelStorage& operator=(const VoxelStorage&) = delete;
+
+    unsigned int GetVoxel(unsigned int index) const;
+
+    bool SetVoxel(unsigned int index, unsigned int value);
+
+    bool Fill(unsigned int first, unsigned int count, unsigned int value);
+
+    bool Write(unsigned int first, unsigned int count, const unsigned int* values);
+
+    // Replaces each voxel in [first, first + count) by function(offset, value), with offset counted from first.
+    // Voxels the function leaves unchanged keep their palette index, so only new values are looked up.
+    template <typename Function>
+    bool Update(unsigned int first, unsigned int count, Function function);
+
+    void Decode(unsigned int first, unsigned int count, unsigned int* output) const;
+
+    unsigned int GetSize() const;
+
+    unsigned int GetBitsPerIndex() const;
+
+    unsigned int GetPaletteSize() const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    unsigned int GetPaletteIndex(unsigned int value, bool compact = true);
+
+    unsigned int GetIndex(unsigned int index) const;
+
+    void SetIndex(unsigned int index, unsigned int paletteIndex);
+
+    void DecodeIndices(unsigned int first, unsigned int count, unsigned int* indices) const;
+
+    // Stores count resolved palette indices starting at first, a word at a time.
+    bool WriteIndices(unsigned int first, unsigned int count, const unsigned int* indices);
+
+    bool FillWord(unsigned int word, unsigned int mask, unsigned int pattern);
+
+    void Compact();
+
+    void Resize(unsigned int bitsPerIndex);
+
+private:
+    unsigned int mSize = 0;
+    unsigned int mBitsPerIndex = 1;
+    unsigned int mBitsShift = 0;
+    unsigned int mIndexMask = 1;
+    unsigned int* mWords = nullptr;
+    unsigned int mPaletteVersion = 0;
+    std::vector<unsigned int> mPalette;
+    std::unordered_map<unsigned int, unsigned int> mPaletteLookup;
+};
+
+template <typename Function>
+bool VoxelStorage::Update(unsigned int first, unsigned int count, Function function) {
+    const unsigned int BlockSize = 256;
+
+    unsigned int indices[BlockSize];
+    unsigned int values[BlockSize];
+    bool changed = false;
+
+    // Updates mostly write a single new value, so the last one resolved is kept; the first palette entry is a
+    // valid start since its index is always 0.
+    unsigned int lastValue = mPalette[0];
+    unsigned int lastIndex = 0;
+
+    for (unsigned int offset = 0; offset < count; offset += BlockSize) {
+        unsigned int blockCount = count - offset < BlockSize ? count - offset : BlockSize;
+
+        DecodeIndices(first + offset, blockCount, indices);
+
+        const unsigned int* palette = mPalette.data();
+        bool blockChanged = false;
+        bool compacted = false;
+
+        for (unsigned int i = 0; i < blockCount; ++i) {
+            unsigned int value = palette[indices[i]];
+            unsigned int result = function(offset + i, value);
+            values[i] = result;
+
+            if (result == value) {
+                continue;
+            }
+
+            if (result != lastValue) {
+                const unsigned int paletteVersion = mPaletteVersion;
+
+                lastValue = result;
+                lastIndex = GetPaletteIndex(result);
+                palette = mPalette.data();
+
+                // A compaction renumbered the storage: the rest of the block is decoded again, and since new
+                // values resolved before it may have been dropped, the whole block goes through Write.
+                if (paletteVersion != mPaletteVersion) {
+                    DecodeIndices(first + offset + i + 1, blockCount - i - 1, indices + i + 1);
+                    lastValue = mPalette[0];
+                    lastIndex = 0;
+                    compacted = true;
+                }
+            }
+
+            indices[i] = lastIndex;
+            blockChanged = true;
+        }
+
+        if (compacted) {
+            changed |= Write(first + offset, blockCount, values);
+        }
+        else if (blockChanged) {
+            changed |= WriteIndices(first + offset, blockCount, indices);
+        }
+    }
+
+    return changed;
+}
@@ -0,0 +1,423 @@
+#include "World.hpp"
+#include "Math.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+// A chunk keeps its level until the error crosses the threshold by this fraction, so that chunks near a boundary
+// do not switch back and forth, each switch rebuilding their whole mesh.
+static constexpr float LevelHysteresis = 0.15f;
+
+ChunkCoordinate World::ToChunkCoordinate(const Vector3& position) {
+    const float size = (float)Chunk::ChunkSize;
+
+    return {
+        (int)floorf((position.X + 0.5f) / size),
+        (int)floorf((position.Y + 0.5f) / size),
+        (int)floorf((position.Z + 0.5f) / size)
+    };
+}
+
+ChunkCoordinate World::ToChunkCoordinate(int x, int y, int z) {
+    const int size = (int)Chunk::ChunkSize;
+
+    return {
+        (x >= 0 ? x : x - size + 1) / size,
+        (y >= 0 ? y : y - size + 1) / size,
+        (z >= 0 ? z : z - size + 1) / size
+    };
+}
+
+World::World(ThreadPool* threadPool)
+    : mThreadPool(threadPool), mLightEngine(threadPool), mMesher(threadPool) {
+    // Layers of data/terrain.png: 1 is grass with dirt below, 2 is stone and 3 is a lamp.
+    mBlockRegistry.Register(1, 0, 2, 3);
+    mBlockRegistry.Register(2, 1);
+    mBlockRegistry.Register(3, 105);
+    mMesher.SetBlockRegistry(&mBlockRegistry);
+
+    mLightEngine.SetEmission(3, LightEngine::MaxLevel);
+}
+
+World::~World() {
+    {
+        std::lock_guard<std::mutex> lock(mGeneratorMutex);
+        mGeneratorRunning = false;
+        mGeneratorRequests.clear();
+    }
+
+    // Jobs still queued find no request and return right away.
+    mThreadPool->Wait(mGeneratorJobs);
+
+    for (auto& result : mGeneratorResults) {
+        delete result.second;
+    }
+
+    for (auto& pair : mChunks) {
+        delete pair.second;
+    }
+}
+
+void World::Update(const Vector3& cameraPosition) {
+    double startTime = glfwGetTime();
+
+    mStatistics.FrameLoads = 0;
+    mStatistics.FrameUnloads = 0;
+
+    ChunkCoordinate center = ToChunkCoordinate(cameraPosition);
+    if (!mCenterValid || center != mCenter) {
+        mCenter = center;
+        mCenterValid = true;
+
+        for (auto it = mChunks.begin(); it != mChunks.end();) {
+            if (!IsInsideRadius(it->first, mCenter, mUnloadHysteresis)) {
+                mLightEngine.RemoveChunk(it->first);
+                delete it->second;
+                it = mChunks.erase(it);
+                mStatistics.FrameUnloads++;
+            }
+            else {
+                ++it;
+            }
+        }
+
+        QueueMissingChunks(mCenter);
+    }
+
+    std::vector<std::pair<ChunkCoordinate, Chunk*>> results;
+    {
+        std::lock_guard<std::mutex> lock(mGeneratorMutex);
+
+        size_t count = Math::Min((int)mGeneratorResults.size(), (int)mMaxLoadsPerFrame);
+        results.assign(mGeneratorResults.begin(), mGeneratorResults.begin() + count);
+        mGeneratorResults.erase(mGeneratorResults.begin(), mGeneratorResults.begin() + count);
+    }
+
+    for (auto& result : results) {
+        mPendingChunks.erase(result.first);
+
+        if (IsInsideRadius(result.first, mCenter, mUnloadHysteresis)) {
+            result.second->SetMeshingMode(mMeshingMode);
+            mChunks[result.first] = result.second;
+            mLightEngine.AddChunk(result.first, result.second);
+            mStatistics.FrameLoads++;
+        }
+        else {
+            delete result.second;
+        }
+    }
+
+    // After the loads, so that new chunks exchange light with their neighbours in the same frame.
+    mLightEngine.Update();
+
+    SelectLevels(cameraPosition);
+
+    mStatistics.LoadedChunks = (unsigned int)mChunks.size();
+    mStatistics.PendingChunks = (unsigned int)mPendingChunks.size();
+    mStatistics.TotalLoads += mStatistics.FrameLoads;
+    mStatistics.TotalUnloads += mStatistics.FrameUnloads;
+    mStatistics.FrameTime = glfwGetTime() - startTime;
+}
+
+void World::Render(Shader* feedbackShader, Shader* voxelizerShader, Shader* cullingShader, Shader* forwardShader, const DepthPyramid* depthPyramid) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mBlockRegistry.GetBufferId());
+
+    for (auto& pair : mChunks) {
+        pair.second->UpdateMesh(feedbackShader, voxelizerShader, &mMesher);
+    }
+
+    mMeshHeap.Draw(cullingShader, forwardShader, depthPyramid);
+}
+
+Chunk* World::GetChunk(const ChunkCoordinate& coordinate) const {
+    auto it = mChunks.find(coordinate);
+    return it != mChunks.end() ? it->second : nullptr;
+}
+
+unsigned int World::GetVoxel(int x, int y, int z) const {
+    ChunkCoordinate coordinate = ToChunkCoordinate(x, y, z);
+
+    Chunk* chunk = GetChunk(coordinate);
+    if (!chunk) {
+        return 0;
+    }
+
+    const int size = (int)Chunk::ChunkSize;
+    return chunk->GetVoxel(x - coordinate.X * size, y - coordinate.Y * size, z - coordinate.Z * size);
+}
+
+void World::SetVoxel(int x, int y, int z, unsigned int value) {
+    ChunkCoordinate coordinate = ToChunkCoordinate(x, y, z);
+
+    Chunk* chunk = GetChunk(coordinate);
+    if (!chunk) {
+        return;
+    }
+
+    const int size = (int)Chunk::ChunkSize;
+    const unsigned int localX = x - coordinate.X * size;
+    const unsigned int localY = y - coordinate.Y * size;
+    const unsigned int localZ = z - coordinate.Z * size;
+
+    chunk->SetVoxel(localX, localY, localZ, value);
+    mLightEngine.Invalidate(coordinate, localX, localY, localZ, localX + 1, localY + 1, localZ + 1);
+}
+
+void World::FillRegion(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, unsigned int value) {
+    if (minX >= maxX || minY >= maxY || minZ >= maxZ) {
+        return;
+    }
+
+    const int size = (int)Chunk::ChunkSize;
+
+    ChunkCoordinate first = ToChunkCoordinate(minX, minY, minZ);
+    ChunkCoordinate last = ToChunkCoordinate(maxX - 1, maxY - 1, maxZ - 1);
+
+    for (int cz = first.Z; cz <= last.Z; ++cz) {
+        for (int cy = first.Y; cy <= last.Y; ++cy) {
+            for (int cx = first.X; cx <= last.X; ++cx) {
+                Chunk* chunk = GetChunk({ cx, cy, cz });
+                if (!chunk) {
+                    continue;
+                }
+
+                const int ox = cx * size;
+                const int oy = cy * size;
+                const int oz = cz * size;
+
+                const unsigned int localMin[3] = {
+                    (unsigned int)Math::Max(minX - ox, 0), (unsigned int)Math::Max(minY - oy, 0), (unsigned int)Math::Max(minZ - oz, 0)
+                };
+                const unsigned int localMax[3] = {
+                    (unsigned int)Math::Min(maxX - ox, size), (unsigned int)Math::Min(maxY - oy, size), (unsigned int)Math::Min(maxZ - oz, size)
+                };
+
+                chunk->FillRegion(localMin[0], localMin[1], localMin[2], localMax[0], localMax[1], localMax[2], value);
+                mLightEngine.Invalidate({ cx, cy, cz }, localMin[0], localMin[1], localMin[2], localMax[0], localMax[1], localMax[2]);
+            }
+        }
+    }
+}
+
+void World::SetLoadRadius(int horizontalRadius, int verticalRadius) {
+    mHorizontalRadius = horizontalRadius;
+    mVerticalRadius = verticalRadius;
+    mCenterValid = false;
+}
+
+void World::SetUnloadHysteresis(int hysteresis) {
+    mUnloadHysteresis = hysteresis;
+    mCenterValid = false;
+}
+
+void World::SetMaxLoadsPerFrame(unsigned int maxLoadsPerFrame) {
+    mMaxLoadsPerFrame = maxLoadsPerFrame;
+}
+
+void World::SetMeshingMode(MeshingMode mode) {
+    mMeshingMode = mode;
+
+    for (auto& pair : mChunks) {
+        pair.second->SetMeshingMode(mode);
+    }
+}
+
+MeshingMode World::GetMeshingMode() const {
+    return mMeshingMode;
+}
+
+void World::SetLevelOfDetail(float projectionScale, float maximumError) {
+    mProjectionScale = projectionScale;
+    mMaximumError = maximumError;
+}
+
+const WorldStatistics& World::GetStatistics() const {
+    return mStatistics;
+}
+
+const MeshHeap& World::GetMeshHeap() const {
+    return mMeshHeap;
+}
+
+const LightStatistics& World::GetLightStatistics() const {
+    return mLightEngine.GetStatistics();
+}
+
+const BlockRegistry& World::GetBlockRegistry() const {
+    return mBlockRegistry;
+}
+
+MeshComparison World::CompareMeshes(CpuMesher& mesher) const {
+    MeshComparison comparison;
+    CpuMesh mesh;
+
+    mesher.SetBlockRegistry(&mBlockRegistry);
+
+    for (auto& pair : mChunks) {
+        const Chunk* chunk = pair.second;
+
+        // Dirty chunks have not been regenerated on the GPU yet, so their feedback is stale.
+        if (chunk->IsDirty() || chunk->GetMeshingMode() != MeshingMode::Culled) {
+            continue;
+        }
+
+        mesher.Mesh(*chunk, mesh);
+
+        unsigned int gpuTriangles = chunk->GetChunkFeedback().indexCount / 3;
+        unsigned int cpuTriangles = (unsigned int)mesh.Indices.size() / 3;
+
+        if (gpuTriangles != cpuTriangles) {
+            printf("Mesh mismatch in chunk (%d, %d, %d): GPU %u triangles, CPU %u triangles\n",
+                pair.first.X, pair.first.Y, pair.first.Z, gpuTriangles, cpuTriangles);
+            comparison.Mismatches++;
+        }
+
+        comparison.Chunks++;
+        comparison.GpuTriangles += gpuTriangles;
+        comparison.CpuTriangles += cpuTriangles;
+    }
+
+    return comparison;
+}
+
+void World::QueueMissingChunks(const ChunkCoordinate& center) {
+    std::lock_guard<std::mutex> lock(mGeneratorMutex);
+
+    for (const ChunkCoordinate& coordinate : mGeneratorRequests) {
+        mPendingChunks.erase(coordinate);
+    }
+
+    mGeneratorRequests.clear();
+
+    std::vector<ChunkCoordinate> missing;
+    for (int y = -mVerticalRadius; y <= mVerticalRadius; ++y) {
+        for (int z = -mHorizontalRadius; z <= mHorizontalRadius; ++z) {
+            for (int x = -mHorizontalRadius; x <= mHorizontalRadius; ++x) {
+                ChunkCoordinate coordinate = { center.X + x, center.Y + y, center.Z + z };
+
+                if (IsInsideRadius(coordinate, center, 0) &&
+                    mChunks.find(coordinate) == mChunks.end() &&
+                    mPendingChunks.find(coordinate) == mPendingChunks.end()) {
+                    missing.push_back(coordinate);
+                }
+            }
+        }
+    }
+
+    std::sort(missing.begin(), missing.end(), [&center](const ChunkCoordinate& lhs, const ChunkCoordinate& rhs) {
+        int lx = lhs.X - center.X, ly = lhs.Y - center.Y, lz = lhs.Z - center.Z;
+        int rx = rhs.X - center.X, ry = rhs.Y - center.Y, rz = rhs.Z - center.Z;
+        return lx * lx + ly * ly + lz * lz < rx * rx + ry * ry + rz * rz;
+    });
+
+    for (const ChunkCoordinate& coordinate : missing) {
+        mPendingChunks.insert(coordinate);
+        mGeneratorRequests.push_back(coordinate);
+
+        mThreadPool->SubmitBackground([this]() { GenerateNextChunk(); }, &mGeneratorJobs);
+    }
+}
+
+bool World::IsInsideRadius(const ChunkCoordinate& coordinate, const ChunkCoordinate& center, int hysteresis) const {
+    int x = coordinate.X - center.X;
+    int y = coordinate.Y - center.Y;
+    int z = coordinate.Z - center.Z;
+    int radius = mHorizontalRadius + hysteresis;
+
+    return x * x + z * z <= radius * radius && Math::Abs(y) <= mVerticalRadius + hysteresis;
+}
+
+void World::SelectLevels(const Vector3& cameraPosition) {
+    for (auto& pair : mChunks) {
+        Chunk* chunk = pair.second;
+
+        // Distance to the closest point of the chunk's box, voxel centres are at integer coordinates.
+        const Vector3 minimum = chunk->GetOrigin() - Vector3(0.5f);
+        const Vector3 maximum = minimum + Vector3((float)Chunk::ChunkSize);
+
+        float distanceSquared = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            float delta = Math::Max(Math::Max(minimum[axis] - cameraPosition[axis], cameraPosition[axis] - maximum[axis]), 0.0f);
+            distanceSquared += delta * delta;
+        }
+
+        // A voxel of level l spans 1 << l units, so its size on screen is (1 << l) * scale / distance.
+        // Neighbouring chunks may end up on different levels; every chunk mesh keeps its faces along the chunk
+        // border, which act as skirts and close the seams between them.
+        const float distance = Math::Sqrt(distanceSquared);
+        const unsigned int current = chunk->GetLevel();
+        unsigned int level = 0;
+
+        while (level + 1 < Chunk::LevelCount) {
+            // Levels up to the current one only have to stay below the widened threshold, coarser ones below
+            // the narrowed one.
+            const float margin = level + 1 <= current ? 1.0f + LevelHysteresis : 1.0f - LevelHysteresis;
+
+            if ((float)(1u << (level + 1)) * mProjectionScale > margin * mMaximumError * distance) {
+                break;
+            }
+
+            level++;
+        }
+
+        chunk->SetLevel(level);
+    }
+}
+
+void World::GenerateNextChunk() {
+    ChunkCoordinate coordinate;
+    {
+        std::lock_guard<std::mutex> lock(mGeneratorMutex);
+
+        if (!mGeneratorRunning || mGeneratorRequests.empty()) {
+            return;
+        }
+
+        coordinate = mGeneratorRequests.front();
+        mGeneratorRequests.pop_front();
+    }
+
+    const float size = (float)Chunk::ChunkSize;
+
+    Chunk* chunk = new Chunk(Vector3(coordinate.X * size, coordinate.Y * size, coordinate.Z * size), &mMeshHeap, mThreadPool);
+    Generate(chunk, coordinate);
+    mLightEngine.LightChunk(*chunk);
+
+    std::lock_guard<std::mutex> lock(mGeneratorMutex);
+    mGeneratorResults.push_back(std::make_pair(coordinate, chunk));
+}
+
+void World::Generate(Chunk* chunk, const ChunkCoordinate& coordinate) const {
+    const float size = (float)Chunk::ChunkSize;
+
+    std::vector<float> heights(Chunk::ChunkSize * Chunk::ChunkSize);
+    for (unsigned int z = 0; z < Chunk::ChunkSize; ++z) {
+        for (unsigned int x = 0; x < Chunk::ChunkSize; ++x) {
+            float wx = coordinate.X * size + x;
+            float wz = coordinate.Z * size + z;
+
+            heights[x + Chunk::ChunkSize * z] = 32.0f +
+                12.0f * Math::Sin(wx * 0.04f) * Math::Cos(wz * 0.035f) +
+                6.0f * Math::Sin((wx + wz) * 0.013f);
+        }
+    }
+
+    std::vector<unsigned int> slab(Chunk::ChunkSize * Chunk::ChunkSize);
+    for (unsigned int z = 0; z < Chunk::ChunkSize; ++z) {
+        for (unsigned int y = 0; y < Chunk::ChunkSize; ++y) {
+            float wy = coordinate.Y * size + y;
+
+            for (unsigned int x = 0; x < Chunk::ChunkSize; ++x) {
+                float height = heights[x + Chunk::ChunkSize * z];
+
+                slab[x + Chunk::ChunkSize * y] = wy < height - 4.0f ? 2 : (wy < height ? 1 : 0);
+            }
+        }
+
+        chunk->SetVoxels(0, 0, z, Chunk::ChunkSize, Chunk::ChunkSize, 1, slab.data());
+    }
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "BlockRegistry.hpp"
+#include "Chunk.hpp"
+#include "ChunkCoordinate.hpp"
+#include "CpuMesher.hpp"
+#include "LightEngine.hpp"
+#include "Math.hpp"
+#include "MeshHeap.hpp"
+#include "Shader.hpp"
+#include "ThreadPool.hpp"
+#include "Vector3.hpp"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+struct WorldStatistics {
+    unsigned int LoadedChunks = 0;
+    unsigned int PendingChunks = 0;
+    unsigned int TotalLoads = 0;
+    unsigned int TotalUnloads = 0;
+    unsigned int FrameLoads = 0;
+    unsigned int FrameUnloads = 0;
+    double FrameTime = 0.0;
+};
+
+struct MeshComparison {
+    unsigned int Chunks = 0;
+    unsigned int Mismatches = 0;
+    unsigned int GpuTriangles = 0;
+    unsigned int CpuTriangles = 0;
+};
+
+class World {
+public:
+    static ChunkCoordinate ToChunkCoordinate(const Vector3& position);
+
+    static ChunkCoordinate ToChunkCoordinate(int x, int y, int z);
+
+public:
+    // Chunks are generated as background jobs on threadPool, which needs at least one worker; lighting and
+    // CPU meshing use it for their parallel loops as well.
+    World(ThreadPool* threadPool);
+
+    ~World();
+
+    void Update(const Vector3& cameraPosition);
+
+    void Render(Shader* feedbackShader, Shader* voxelizerShader, Shader* cullingShader, Shader* forwardShader, const DepthPyramid* depthPyramid);
+
+    Chunk* GetChunk(const ChunkCoordinate& coordinate) const;
+
+    unsigned int GetVoxel(int x, int y, int z) const;
+
+    void SetVoxel(int x, int y, int z, unsigned int value);
+
+    void FillRegion(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, unsigned int value);
+
+    template <typename Function>
+    void UpdateRegion(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, Function function);
+
+    void SetLoadRadius(int horizontalRadius, int verticalRadius);
+
+    void SetUnloadHysteresis(int hysteresis);
+
+    void SetMaxLoadsPerFrame(unsigned int maxLoadsPerFrame);
+
+    void SetMeshingMode(MeshingMode mode);
+
+    MeshingMode GetMeshingMode() const;
+
+    // Chunks are meshed at the coarsest level whose voxels stay within maximumError pixels on screen.
+    // projectionScale is the number of pixels one unit covers at distance one, half the viewport height times
+    // the cotangent of half the vertical field of view; 0 keeps every chunk at full resolution.
+    void SetLevelOfDetail(float projectionScale, float maximumError);
+
+    const WorldStatistics& GetStatistics() const;
+
+    const MeshHeap& GetMeshHeap() const;
+
+    const LightStatistics& GetLightStatistics() const;
+
+    const BlockRegistry& GetBlockRegistry() const;
+
+    MeshComparison CompareMeshes(CpuMesher& mesher) const;
+
+private:
+    void QueueMissingChunks(const ChunkCoordinate& center);
+
+    bool IsInsideRadius(const ChunkCoordinate& coordinate, const ChunkCoordinate& center, int hysteresis) const;
+
+    void SelectLevels(const Vector3& cameraPosition);
+
+    // Generates the first requested chunk, if any; one job is queued per request.
+    void GenerateNextChunk();
+
+    void Generate(Chunk* chunk, const ChunkCoordinate& coordinate) const;
+
+private:
+    std::unordered_map<ChunkCoordinate, Chunk*, ChunkCoordinateHash> mChunks;
+    std::unordered_set<ChunkCoordinate, ChunkCoordinateHash> mPendingChunks;
+    ChunkCoordinate mCenter = { 0, 0, 0 };
+    bool mCenterValid = false;
+
+    int mHorizontalRadius = 3;
+    int mVerticalRadius = 0;
+    int mUnloadHysteresis = 1;
+    unsigned int mMaxLoadsPerFrame = 4;
+    MeshingMode mMeshingMode = MeshingMode::Culled;
+    float mProjectionScale = 0.0f;
+    float mMaximumError = 8.0f;
+
+    ThreadPool* mThreadPool = nullptr;
+    BlockRegistry mBlockRegistry;
+    LightEngine mLightEngine;
+    CpuMesher mMesher;
+    MeshHeap mMeshHeap;
+
+    JobCounter mGeneratorJobs;
+    std::mutex mGeneratorMutex;
+    std::deque<ChunkCoordinate> mGeneratorRequests;
+    std::vector<std::pair<ChunkCoordinate, Chunk*>> mGeneratorResults;
+    bool mGeneratorRunning = true;
+
+    WorldStatistics mStatistics;
+};
+
+template <typename Function>
+void World::UpdateRegion(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, Function function) {
+    if (minX >= maxX || minY >= maxY || minZ >= maxZ) {
+        return;
+    }
+
+    const int size = (int)Chunk::ChunkSize;
+
+    ChunkCoordinate first = ToChunkCoordinate(minX, minY, minZ);
+    ChunkCoordinate last = ToChunkCoordinate(maxX - 1, maxY - 1, maxZ - 1);
+
+    for (int cz = first.Z; cz <= last.Z; ++cz) {
+        for (int cy = first.Y; cy <= last.Y; ++cy) {
+            for (int cx = first.X; cx <= last.X; ++cx) {
+                Chunk* chunk = GetChunk({ cx, cy, cz });
+                if (!chunk) {
+                    continue;
+                }
+
+                const int ox = cx * size;
+                const int oy = cy * size;
+                const int oz = cz * size;
+
+                const unsigned int localMin[3] = {
+                    (unsigned int)Math::Max(minX - ox, 0), (unsigned int)Math::Max(minY - oy, 0), (unsigned int)Math::Max(minZ - oz, 0)
+                };
+                const unsigned int localMax[3] = {
+                    (unsigned int)Math::Min(maxX - ox, size), (unsigned int)Math::Min(maxY - oy, size), (unsigned int)Math::Min(maxZ - oz, size)
+                };
+
+                chunk->UpdateRegion(localMin[0], localMin[1], localMin[2], localMax[0], localMax[1], localMax[2],
+                    [&](unsigned int x, unsigned int y, unsigned int z, unsigned int value) {
+                        return function(ox + (int)x, oy + (int)y, oz + (int)z, value);
+                    });
+
+                mLightEngine.Invalidate({ cx, cy, cz }, localMin[0], localMin[1], localMin[2], localMax[0], localMax[1], localMax[2]);
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#include "TextureImage.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Converts images into baked texture containers (see TextureFile) that load without decoding:
+//   TextureBaker [--tiles <width> <height>] [--no-mipmaps] [--bc1 | --bc3] <input> <output>
+int main(int argc, char* argv[]) {
+    TextureOptions options;
+    const char* input = nullptr;
+    const char* output = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--tiles") == 0 && i + 2 < argc) {
+            options.TileWidth = atoi(argv[++i]);
+            options.TileHeight = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--no-mipmaps") == 0) {
+            options.Mipmaps = false;
+        }
+        else if (strcmp(argv[i], "--bc1") == 0) {
+            options.Compression = TextureCompression::BC1;
+        }
+        else if (strcmp(argv[i], "--bc3") == 0) {
+            options.Compression = TextureCompression::BC3;
+        }
+        else if (!input) {
+            input = argv[i];
+        }
+        else if (!output) {
+            output = argv[i];
+        }
+        else {
+            input = nullptr;
+            break;
+        }
+    }
+
+    if (!input || !output) {
+        printf("Usage: %s [--tiles <width> <height>] [--no-mipmaps] [--bc1 | --bc3] <input> <output>\n", argv[0]);
+        return 1;
+    }
+
+    TextureImage image;
+    if (!image.Decode(input, options)) {
+        printf("Failed to load %s\n", input);
+        return 1;
+    }
+
+    if (!image.Save(output)) {
+        printf("Failed to write %s\n", output);
+        return 1;
+    }
+
+    printf("%s -> %s: %u layers, %u levels, %.1f KB\n", input, output, image.LayerCount, (unsigned int)image.Levels.size(), image.Data.size() / 1024.0);
+    return 0;
+}